@@ -0,0 +1,1476 @@
+/*====================================================================
+rpt1bench:  Check and time the stages of rpt1pgm's extraction
+
+Copyright (C) 2021  Larry Anta
+
+
+This is a tool for working on rpt1pgm, not part of processing your
+invoices; the script doesn't use it.  Build it the same way as rpt1pgm,
+from the same directory (it compiles rpt1pgm.c in, see below):
+
+    gcc -O2 -pthread -o rpt1bench rpt1bench.c -lz
+
+or 'make rpt1bench' (with INFLATE=... to check another inflate backend).
+
+Usage:
+
+    rpt1bench stage {invoiceName | @manifestFile | -}...
+
+where stage is ascii85, inflate, scan, tokens or alloc, and the invoices
+are named as they are for 'rpt1pgm -a' (see the Benchmarks notes below).
+======================================================================*/
+
+
+
+
+/*====================================================================
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+======================================================================*/
+
+
+/*==================================================================
+All of rpt1pgm.c is compiled in here, with its main() renamed, so
+that what's checked and timed is exactly the code rpt1pgm runs, its
+file-scope variables and static functions included, and none of the
+code below ends up in rpt1pgm itself.
+====================================================================*/
+#define main rpt1pgmMain
+#include "rpt1pgm.c"
+#undef main
+
+#define MAXCHECKRUNS      20     /* most runs in a 'tokens' random stream */
+
+/* Function prototypes */
+int runBenchmark(char *what);
+int benchAscii85(void);
+typedef int (*inflateBackendFn)(void *ctx, const unsigned char *in, unsigned long int inLen,
+                                unsigned char *out, unsigned long int outSize,
+                                unsigned long int *outLen);
+int benchInflate(void);
+int benchParallelInflate(struct inflateTables *tables, z_stream *zs, const unsigned char *deflated,
+                         const unsigned long int *defOff, const unsigned long int *defLen);
+int benchAlloc(void);
+int benchScan(void);
+int gatherContent(unsigned char **content, unsigned long int **contentOff,
+                  unsigned long int **contentLen);
+void benchBracket(struct worker *w, const unsigned char *in, unsigned long int len,
+                  unsigned long int piece);
+int benchTokens(void);
+void benchTokenize(struct worker *w, const unsigned char *in, unsigned long int len,
+                   unsigned long int piece);
+unsigned long int makeContent(unsigned long long int *seed, char *out, int runs,
+                              struct textRun *expect, unsigned char *text);
+int inflateWithZlib(void *ctx, const unsigned char *in, unsigned long int inLen,
+                    unsigned char *out, unsigned long int outSize, unsigned long int *outLen);
+#if defined(INFLATE_ZLIBNG)
+int inflateWithZlibNg(void *ctx, const unsigned char *in, unsigned long int inLen,
+                      unsigned char *out, unsigned long int outSize, unsigned long int *outLen);
+#endif
+int inflateWithBuiltin(void *ctx, const unsigned char *in, unsigned long int inLen,
+                       unsigned char *out, unsigned long int outSize, unsigned long int *outLen);
+int gatherStreams(char **corpus, unsigned long int **streamOff,
+                  unsigned long int **streamLen);
+int ascii85decodeAll(const char *in, unsigned long int inLen, char *out,
+                     unsigned long int piece, unsigned long int *outLen);
+unsigned long int ascii85encode(const unsigned char *in, unsigned long int n, char *out,
+                                unsigned long long int *seed);
+unsigned long long int benchRandom(unsigned long long int *seed);
+unsigned long int benchDeflate(const unsigned char *in, unsigned long int inLen,
+                               unsigned char *out, unsigned long int outSize,
+                               int level, int strategy);
+double benchSeconds(void);
+
+
+
+
+int main(int argc, char *argv[]) {
+
+  /*=========================================================
+  Gather the invoices named on the command line, as 'rpt1pgm
+  -a' would, and run the benchmark named before them.
+  ===========================================================*/
+
+  int rc;
+
+  if ( argc<3 ) {
+    printf("Usage: %s {ascii85 | inflate | scan | tokens | alloc} {invoiceName | @manifestFile | -}...\n",
+           argv[0]);
+    return 1;
+  }
+
+  ascii85init();
+  chooseScanKernel();
+  rc = addInvoiceArgs(argc, argv, 2);
+  if ( rc )
+    return rc;
+  return runBenchmark(argv[1]);
+} /* main() */
+
+
+
+
+int runBenchmark(char *what) {
+
+  /* Run the benchmark named on the command line (see below). */
+
+  if ( strcmp(what,"ascii85")==0 )
+    return benchAscii85();
+  if ( strcmp(what,"inflate")==0 )
+    return benchInflate();
+  if ( strcmp(what,"alloc")==0 )
+    return benchAlloc();
+  if ( strcmp(what,"scan")==0 )
+    return benchScan();
+  if ( strcmp(what,"tokens")==0 )
+    return benchTokens();
+  printf("rpt1bench: Unknown benchmark %s.  Aborting.\n", what);
+  return 1;
+} /* runBenchmark() */
+
+
+
+/*==========================================================================
+Benchmarks
+
+'rpt1bench what {invoiceName | @manifestFile | -}...' times one stage
+of rpt1pgm's extraction over the given invoices, on one thread, and reports its
+throughput.  Nothing is written to report1.  'what' may be:
+
+  ascii85   ascii85decode() with each group decoder this CPU can run,
+            including none (scalar).  Before timing anything, every decoder's
+            output is checked against the scalar output, both for the
+            invoices' own streams and for a few thousand random streams
+            (with 'z's, white space and short final groups) decoded in
+            randomly sized pieces.
+
+  inflate   Each inflate backend rpt1pgm was built with (zlib always, and
+            builtin always; zlib-ng too if that's the one chosen), one whole
+            stream at a time.  Every backend must first agree with zlib on
+            the invoices' own Flate data and on 6000 random streams from
+            deflate() at each level and strategy, some of them damaged or
+            cut short: the same verdict on whether the data is good, and the
+            same output when it is.  Then parallelInflate(), on 4 threads,
+            over 8MB of content deflated at levels 1, 6 and 9 with each
+            strategy, and stored, whole, damaged and cut short: it must
+            either decode each stream exactly as zlib does, byte for byte,
+            or leave it to builtin, and it must decode every whole one.
+            Then its time against builtin's for one such stream at each of
+            levels 1, 6 and 9: on this machine's CPUs, and (from how long
+            each step's busiest thread took) with a CPU per thread.
+
+  scan      bracketFSA() with each scan kernel this CPU can run, including
+            none (scalar), over the invoices' decoded content streams fed
+            to it a window at a time.  Every kernel's text is first checked
+            against the scalar text, for the invoices and for 20000 random
+            streams thick with brackets, backslashes and newlines, fed in
+            randomly sized pieces.
+
+  tokens    tokenizeContent(), the -xy tokenizer, against bracketFSA() (with
+            the scan kernel it would use), over the invoices' decoded content
+            fed a window at a time.  First, 20000 random streams, each
+            showing known runs of text (spelt as literal, octal, escaped,
+            nested, hex and TJ-array strings, placed by Tm, Td, TD, T*, ' and
+            cm, among comments, marked-content and inline images) and fed in
+            randomly sized pieces, must give back those very runs; and for
+            each invoice the runs' text must be the FSA's text.
+
+  alloc     Not a timing: batch mode over the invoices twice (each one is
+            queued a second time), on 1 thread and then on 4, with report1
+            going to /dev/null.  It reports how many malloc() and realloc()
+            calls the workers' arenas and scratch buffers made, and how
+            many invoices needed any at all; once the workers have seen
+            their biggest invoices, the rest should need none.
+==========================================================================*/
+
+/* A small, fast pseudo-random number generator (xorshift64) for the checks. */
+unsigned long long int benchRandom(unsigned long long int *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 7;
+  *seed ^= *seed << 17;
+  return *seed;
+} /* benchRandom() */
+
+
+double benchSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec/1e9;
+} /* benchSeconds() */
+
+
+
+
+int gatherStreams(char **corpus, unsigned long int **streamOff,
+                  unsigned long int **streamLen) {
+
+  /*==============================================================
+  Copy the (first) ascii85 content stream of every invoice in the
+  jobs array into one buffer, *corpus, noting where each starts and how long it
+  is.  Return 0, or the return code for main() to give.
+  ================================================================*/
+
+  struct worker w;
+  struct pdfStream *streams;
+  char *wholeInv, *bigger;
+  const char *startp;
+  unsigned long int wholeInvLen, len, used, size, i, streamCount;
+  int mapped, rc;
+
+  memset(&w, 0, sizeof(w));
+  *corpus    = NULL;
+  *streamOff = malloc(jobCount*sizeof(unsigned long int));
+  *streamLen = malloc(jobCount*sizeof(unsigned long int));
+  if ( !*streamOff || !*streamLen ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+  used = size = 0;
+  for ( i=0; i<jobCount; i++ ) {
+    rc = loadInvoice(&w, &jobs[i], &wholeInv, &wholeInvLen, &mapped);
+    if ( !rc ) {
+      rc = findContents(&w, wholeInv, wholeInvLen, &streams, &streamCount);
+      if ( !rc && streams[0].filter[0]!=FILTER_ASCII85 ) {
+        printf("rpt1bench: Content stream isn't /ASCII85Decode.  Aborting.\n");
+        rc = 25;
+      }
+      if ( !rc ) {
+        startp = (const char *)streams[0].data;
+        len    = streams[0].len;
+      }
+      if ( !rc && used+len > size ) {
+        size   = 2*(used+len);
+        bigger = realloc(*corpus, size);
+        if ( !bigger ) {
+          printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+          rc = 20;
+        }
+        else *corpus = bigger;
+      }
+      if ( !rc ) {
+        memcpy(*corpus+used, startp, len);
+        (*streamOff)[i] = used;
+        (*streamLen)[i] = len;
+        used += len;
+      }
+      unloadInvoice(wholeInv, wholeInvLen, mapped);
+    }
+    if ( rc ) {
+      printf("rpt1bench: Failed on invoice %s.  (RC:%d)\n", jobs[i].name, rc);
+      releaseWorker(&w);
+      return rc;
+    }
+  }
+  releaseWorker(&w);
+  return 0;
+} /* gatherStreams() */
+
+
+
+
+int ascii85decodeAll(const char *in, unsigned long int inLen, char *out,
+                     unsigned long int piece, unsigned long int *outLen) {
+
+  /*==============================================================
+  Decode a whole ascii85 stream by calling ascii85decode() as many
+  times as it takes, giving it at most 'piece' bytes of output
+  room each time.  'out' must have room for 4*inLen bytes.
+  ================================================================*/
+
+  struct ascii85State d;
+  unsigned long int used, produced;
+  int rc;
+
+  memset(&d, 0, sizeof(d));
+  *outLen = 0;
+  while ( !d.done ) {
+    rc = ascii85decode(&d, in, inLen, out+*outLen, piece, &used, &produced);
+    if ( rc )
+      return rc;
+    in      += used;
+    inLen   -= used;
+    *outLen += produced;
+  }
+  return 0;
+} /* ascii85decodeAll() */
+
+
+
+
+unsigned long int ascii85encode(const unsigned char *in, unsigned long int n, char *out,
+                                unsigned long long int *seed) {
+
+  /*==============================================================
+  The reverse of ascii85decode(), for the random checks only.  It
+  sprinkles the six PDF white-space characters through its output
+  and ends it with the EOD.  'out' needs room for 3*n+8 bytes.
+  ================================================================*/
+
+  static const char ws[6] = { '\0', '\t', '\n', '\f', '\r', ' ' };
+  unsigned long long int sum;
+  unsigned long int i, len = 0;
+  int k, g;
+  char digits[5];
+
+  for ( i=0; i<n; i+=4 ) {
+    g = (n-i>=4) ? 4 : n-i;
+    sum = 0;
+    for ( k=0; k<4; k++ )
+      sum = (sum<<8) | (k<g ? in[i+k] : 0);
+    if ( g==4 && sum==0 )
+      out[len++] = 'z';
+    else {
+      for ( k=4; k>=0; k-- ) {
+        digits[k] = '!' + sum%85;
+        sum /= 85;
+      }
+      for ( k=0; k<=g; k++ ) {
+        out[len++] = digits[k];
+        if ( benchRandom(seed)%16 == 0 )
+          out[len++] = ws[benchRandom(seed)%6];
+      }
+    }
+  }
+  out[len++] = '~';
+  out[len++] = '>';
+  return len;
+} /* ascii85encode() */
+
+
+
+
+int benchAscii85(void) {
+
+  /* See the Benchmarks notes above. */
+
+  struct { const char *name; ascii85kernelFn fn; } kernels[4];
+  int kernelCount, k, rc;
+  char *corpus, *outA, *outB;
+  unsigned char *raw;
+  unsigned long int *streamOff, *streamLen;
+  unsigned long int i, total, maxLen, lenA, lenB, n, piece, rounds, r;
+  unsigned long long int seed = 0x9E3779B97F4A7C15ULL;
+  double t0, secs, scalarRate = 0.0;
+
+  /* Which decoders can this CPU run? */
+  kernelCount = 0;
+  kernels[kernelCount].name = "scalar";
+  kernels[kernelCount++].fn = NULL;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("sse4.1") ) {
+    kernels[kernelCount].name = "sse4.1";
+    kernels[kernelCount++].fn = ascii85groupsSSE41;
+  }
+  if ( __builtin_cpu_supports("avx2") ) {
+    kernels[kernelCount].name = "avx2";
+    kernels[kernelCount++].fn = ascii85groupsAVX2;
+  }
+  if ( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") ) {
+    kernels[kernelCount].name = "avx512";
+    kernels[kernelCount++].fn = ascii85groupsAVX512;
+  }
+#endif
+
+  rc = gatherStreams(&corpus, &streamOff, &streamLen);
+  if ( rc )
+    return rc;
+  total = maxLen = 0;
+  for ( i=0; i<jobCount; i++ ) {
+    total += streamLen[i];
+    if ( streamLen[i] > maxLen )
+      maxLen = streamLen[i];
+  }
+  if ( maxLen < 3*4096+8 )
+    maxLen = 3*4096+8;           /* room for the random checks too */
+  outA = malloc(4*maxLen);
+  outB = malloc(4*maxLen);
+  raw  = malloc(maxLen);
+  if ( !outA || !outB || !raw ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+
+
+  /*==========================================================
+  Differential check: every decoder must produce exactly what
+  the scalar code produces from the invoices' streams, and
+  exactly what was encoded in the random streams.
+  ============================================================*/
+  for ( k=0; k<kernelCount; k++ ) {
+    for ( i=0; i<jobCount && k>0; i++ ) {
+      ascii85kernel = NULL;
+      rc  = ascii85decodeAll(corpus+streamOff[i], streamLen[i], outA, FILTERCHUNK, &lenA);
+      ascii85kernel = kernels[k].fn;
+      rc |= ascii85decodeAll(corpus+streamOff[i], streamLen[i], outB, FILTERCHUNK, &lenB);
+      if ( rc || lenA!=lenB || memcmp(outA,outB,lenA)!=0 ) {
+        printf("ascii85 check FAILED: %s differs from scalar on %s\n", kernels[k].name, jobs[i].name);
+        return 24;
+      }
+    }
+    for ( r=0; r<5000; r++ ) {
+      n = benchRandom(&seed) % 4096;
+      for ( i=0; i<n; i++ )      /* random bytes, with runs of zeros to make 'z's */
+        raw[i] = (benchRandom(&seed)%4 == 0) ? 0 : (unsigned char)benchRandom(&seed);
+      lenA  = ascii85encode(raw, n, (char *)outB, &seed);
+      piece = 4 + benchRandom(&seed)%64;
+      ascii85kernel = kernels[k].fn;
+      rc = ascii85decodeAll(outB, lenA, outA, piece, &lenB);
+      if ( rc || lenB!=n || memcmp(outA,raw,n)!=0 ) {
+        printf("ascii85 check FAILED: %s on random stream %lu (%lu bytes)\n", kernels[k].name, r, n);
+        return 24;
+      }
+    }
+  }
+  printf("ascii85 check: %lu invoice streams and 5000 random streams decode identically with",
+         jobCount);
+  for ( k=0; k<kernelCount; k++ )
+    printf(" %s", kernels[k].name);
+  printf("\n");
+
+
+  /*======================================================
+  Throughput, in bytes of ascii85 input per second.  Each
+  decoder gets at least a second's worth of rounds.
+  ========================================================*/
+  printf("ascii85 throughput over %lu bytes of ascii85 in %lu invoices:\n", total, jobCount);
+  for ( k=0; k<kernelCount; k++ ) {
+    ascii85kernel = kernels[k].fn;
+    rounds = 0;
+    t0 = benchSeconds();
+    do {
+      for ( i=0; i<jobCount; i++ )
+        (void)ascii85decodeAll(corpus+streamOff[i], streamLen[i], outA, FILTERCHUNK, &lenA);
+      rounds++;
+      secs = benchSeconds() - t0;
+    } while ( secs < 1.0 );
+    if ( k==0 )
+      scalarRate = rounds*total/secs;
+    printf("  %-8s %14.0f bytes/s  (%.2fx scalar)\n", kernels[k].name,
+           rounds*total/secs, rounds*total/secs/scalarRate);
+  }
+
+  chooseAscii85Kernel();
+  printf("chooseAscii85Kernel() picks %s on this CPU\n", ascii85kernelName);
+  free(corpus);
+  free(streamOff);
+  free(streamLen);
+  free(outA);
+  free(outB);
+  free(raw);
+  return 0;
+} /* benchAscii85() */
+
+
+
+
+int inflateWithZlib(void *ctx, const unsigned char *in, unsigned long int inLen,
+                    unsigned char *out, unsigned long int outSize, unsigned long int *outLen) {
+
+  /* One whole zlib stream through zlib's inflate(), for benchInflate(). */
+
+  z_stream *zs = ctx;
+  int rc;
+
+  inflateReset(zs);
+  zs->next_in   = (unsigned char *)in;
+  zs->avail_in  = inLen;
+  zs->next_out  = out;
+  zs->avail_out = outSize;
+  rc = inflate(zs, Z_FINISH);
+  *outLen = outSize - zs->avail_out;
+  return rc != Z_STREAM_END;
+} /* inflateWithZlib() */
+
+
+#if defined(INFLATE_ZLIBNG)
+int inflateWithZlibNg(void *ctx, const unsigned char *in, unsigned long int inLen,
+                      unsigned char *out, unsigned long int outSize, unsigned long int *outLen) {
+
+  /* The same, through zlib-ng's zng_inflate(). */
+
+  zng_stream *zs = ctx;
+  int rc;
+
+  zng_inflateReset(zs);
+  zs->next_in   = (void *)in;
+  zs->avail_in  = inLen;
+  zs->next_out  = out;
+  zs->avail_out = outSize;
+  rc = zng_inflate(zs, Z_FINISH);
+  *outLen = outSize - zs->avail_out;
+  return rc != Z_STREAM_END;
+} /* inflateWithZlibNg() */
+#endif
+
+
+int inflateWithBuiltin(void *ctx, const unsigned char *in, unsigned long int inLen,
+                       unsigned char *out, unsigned long int outSize, unsigned long int *outLen) {
+
+  /* The same, through builtinInflate(). */
+
+  unsigned long int used;
+
+  return builtinInflate(ctx, in, inLen, out, outSize, &used, outLen) != 0;
+} /* inflateWithBuiltin() */
+
+
+
+
+int benchInflate(void) {
+
+  /* See the Benchmarks notes above. */
+
+  static const int strategies[5] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY,
+                                     Z_RLE, Z_FIXED };
+  struct { const char *name; inflateBackendFn fn; void *ctx; } backends[3];
+  int backendCount, k, rc, okA, okB, level = 0, strategy = 0;
+  char *corpus, *text;
+  unsigned char *deflated, *raw, *packed, *outA, *outB;
+  unsigned long int *streamOff, *streamLen, *defOff, *defLen;
+  unsigned long int i, j, n = 0, total, used, maxOut, lenA, lenB, rounds, r, packedLen;
+  unsigned long int mismatches = 0, agreedBad = 0;
+  unsigned long long int seed = 0x9E3779B97F4A7C15ULL;
+  z_stream zs, zc;
+#if defined(INFLATE_ZLIBNG)
+  zng_stream zngs;
+#endif
+  struct inflateTables *tables;
+  double t0, secs, zlibRate = 0.0;
+
+  /* The backends this rpt1pgm was built with, zlib first */
+  memset(&zs, 0, sizeof(zs));
+  tables = malloc(sizeof(struct inflateTables));
+  if ( inflateInit(&zs)!=Z_OK || !tables ) {
+    printf("rpt1bench: Can't set up zlib for the benchmark.  Aborting.\n");
+    return 20;
+  }
+  backendCount = 0;
+  backends[backendCount].name  = "zlib";
+  backends[backendCount].fn    = inflateWithZlib;
+  backends[backendCount++].ctx = &zs;
+#if defined(INFLATE_ZLIBNG)
+  memset(&zngs, 0, sizeof(zngs));
+  if ( zng_inflateInit(&zngs)!=Z_OK ) {
+    printf("rpt1bench: Can't set up zlib-ng for the benchmark.  Aborting.\n");
+    return 20;
+  }
+  backends[backendCount].name  = "zlib-ng";
+  backends[backendCount].fn    = inflateWithZlibNg;
+  backends[backendCount++].ctx = &zngs;
+#endif
+  backends[backendCount].name  = "builtin";
+  backends[backendCount].fn    = inflateWithBuiltin;
+  backends[backendCount++].ctx = tables;
+
+  /* The invoices' Flate data: their ascii85 streams, decoded */
+  rc = gatherStreams(&corpus, &streamOff, &streamLen);
+  if ( rc )
+    return rc;
+  total = 0;
+  for ( i=0; i<jobCount; i++ )
+    total += streamLen[i];
+  deflated = malloc(4*total + 4*4096);
+  defOff   = malloc(jobCount*sizeof(unsigned long int));
+  defLen   = malloc(jobCount*sizeof(unsigned long int));
+  if ( !deflated || !defOff || !defLen ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+  used = 0;
+  for ( i=0; i<jobCount; i++ ) {
+    rc = ascii85decodeAll(corpus+streamOff[i], streamLen[i], (char *)deflated+used,
+                          FILTERCHUNK, &defLen[i]);
+    if ( rc ) {
+      printf("rpt1bench: Failed on invoice %s.  (RC:%d)\n", jobs[i].name, rc);
+      return rc;
+    }
+    defOff[i] = used;
+    used     += defLen[i];
+  }
+
+  /* How much room the output needs: the biggest invoice stream, or a random one */
+  maxOut = 65536;
+  outA = malloc(maxOut);
+  for ( i=0; i<jobCount && outA; i++ ) {
+    while ( inflateWithZlib(&zs, deflated+defOff[i], defLen[i], outA, maxOut, &lenA)
+            && zs.avail_out==0 ) {
+      maxOut *= 2;
+      free(outA);
+      if ( !(outA = malloc(maxOut)) )
+        break;
+    }
+  }
+  outB   = malloc(maxOut);
+  raw    = malloc(65536);
+  packed = malloc(compressBound(65536));
+  if ( !outA || !outB || !raw || !packed ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+
+
+  /*==========================================================
+  Differential check: for every stream, every backend must
+  agree with zlib on whether it's good Flate data and, if it
+  is, on what it decodes to.  The random streams are made by
+  zlib's deflate() at every level with every strategy, then
+  some are damaged: a byte changed, or the end cut off.
+  ============================================================*/
+  for ( r=0; r<jobCount+6000; r++ ) {
+    if ( r < jobCount ) {
+      text      = (char *)deflated+defOff[r];
+      packedLen = defLen[r];
+    }
+    else {
+      n = benchRandom(&seed) % 65536;
+      switch ( benchRandom(&seed) % 3 ) {
+        case 0:  for ( j=0; j<n; j++ )           /* noise */
+                   raw[j] = benchRandom(&seed);
+                 break;
+        case 1:  for ( j=0; j<n; j++ )           /* something like a content stream */
+                   raw[j] = "BT ()Tj ET 0123456789.\n"[benchRandom(&seed)%23];
+                 break;
+        default: for ( j=0; j<n; j++ )           /* runs */
+                   raw[j] = (j==0 || benchRandom(&seed)%32==0) ? benchRandom(&seed) : raw[j-1];
+                 break;
+      }
+      level    = (r-jobCount) % 10;
+      strategy = strategies[((r-jobCount)/10) % 5];
+      memset(&zc, 0, sizeof(zc));
+      if ( deflateInit2(&zc, level, Z_DEFLATED, 15, 8, strategy) != Z_OK ) {
+        printf("rpt1bench: Can't set up deflate() for the benchmark.  Aborting.\n");
+        return 20;
+      }
+      zc.next_in   = raw;
+      zc.avail_in  = n;
+      zc.next_out  = packed;
+      zc.avail_out = compressBound(65536);
+      deflate(&zc, Z_FINISH);
+      packedLen = zc.total_out;
+      deflateEnd(&zc);
+      switch ( (r-jobCount) % 7 ) {
+        case 5:  packed[benchRandom(&seed)%packedLen] ^= 1 << benchRandom(&seed)%8;
+                 break;
+        case 6:  packedLen = benchRandom(&seed) % packedLen;
+                 break;
+      }
+      text = (char *)packed;
+    }
+    okA = !inflateWithZlib(&zs, (unsigned char *)text, packedLen, outA, maxOut, &lenA);
+    if ( r>=jobCount && (r-jobCount)%7<5 && (!okA || lenA!=n || memcmp(outA,raw,n)!=0) ) {
+      printf("inflate check FAILED: zlib doesn't round-trip random stream %lu\n", r-jobCount);
+      return 24;
+    }
+    for ( k=1; k<backendCount; k++ ) {
+      okB = !backends[k].fn(backends[k].ctx, (unsigned char *)text, packedLen, outB, maxOut, &lenB);
+      if ( okA!=okB || (okA && (lenA!=lenB || memcmp(outA,outB,lenA)!=0)) ) {
+        if ( r < jobCount )
+          printf("inflate check FAILED: %s differs from zlib on %s\n", backends[k].name, jobs[r].name);
+        else
+          printf("inflate check FAILED: %s differs from zlib on random stream %lu"
+                 " (level %d, strategy %d)\n", backends[k].name, r-jobCount, level, strategy);
+        mismatches++;
+      }
+    }
+    agreedBad += !okA;
+  }
+  if ( mismatches )
+    return 24;
+  printf("inflate check: %lu invoice streams and 6000 random streams (%lu of them bad) decode"
+         " identically with", jobCount, agreedBad);
+  for ( k=0; k<backendCount; k++ )
+    printf(" %s", backends[k].name);
+  printf("\n");
+
+
+  /*======================================================
+  Throughput, in bytes of decoded output per second.  Each
+  backend gets at least a second's worth of rounds.
+  ========================================================*/
+  total = 0;
+  for ( i=0; i<jobCount; i++ ) {
+    (void)inflateWithZlib(&zs, deflated+defOff[i], defLen[i], outA, maxOut, &lenA);
+    total += lenA;
+  }
+  printf("inflate throughput over %lu decoded bytes in %lu invoices:\n", total, jobCount);
+  for ( k=0; k<backendCount; k++ ) {
+    rounds = 0;
+    t0 = benchSeconds();
+    do {
+      for ( i=0; i<jobCount; i++ )
+        (void)backends[k].fn(backends[k].ctx, deflated+defOff[i], defLen[i], outA, maxOut, &lenA);
+      rounds++;
+      secs = benchSeconds() - t0;
+    } while ( secs < 1.0 );
+    if ( k==0 )
+      zlibRate = rounds*total/secs;
+    printf("  %-8s %14.0f bytes/s  (%.2fx zlib)\n", backends[k].name,
+           rounds*total/secs, rounds*total/secs/zlibRate);
+  }
+
+  rc = benchParallelInflate(tables, &zs, deflated, defOff, defLen);
+  if ( rc )
+    return rc;
+
+  inflateEnd(&zs);
+#if defined(INFLATE_ZLIBNG)
+  zng_inflateEnd(&zngs);
+#endif
+  free(tables);
+  free(corpus);
+  free(streamOff);
+  free(streamLen);
+  free(deflated);
+  free(defOff);
+  free(defLen);
+  free(outA);
+  free(outB);
+  free(raw);
+  free(packed);
+  return 0;
+} /* benchInflate() */
+
+
+
+int benchParallelInflate(struct inflateTables *tables, z_stream *zs, const unsigned char *deflated,
+                         const unsigned long int *defOff, const unsigned long int *defLen) {
+
+  /*==============================================================
+  For 'inflate': parallelInflate() on 4 threads, over 8MB of
+  content (the invoices' own, spliced with made-up lines of
+  text-showing operators) deflated at levels 1, 6 and 9 with each
+  strategy, and stored, each stream also damaged (a bit flipped)
+  and cut short.  Whatever it decodes must be exactly what zlib
+  decodes; if it gives up (INFLATE_SERIAL), builtinInflate() takes
+  over, and that has been checked against zlib already.  Then its
+  time against builtinInflate()'s.
+  ================================================================*/
+
+  static const int strategies[5] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY,
+                                     Z_RLE, Z_FIXED };
+  static const int levels[3] = { 1, 6, 9 };
+  const unsigned long int textSize = 8*1024*1024;
+  const int threads = 4;
+  unsigned char *text, *packed, *outA;
+  unsigned long int used, i, n, packedLen, lenA, lenB, inUsed, bound, rounds;
+  unsigned long int checked = 0, parallel = 0;
+  unsigned long long int seed = 0x9E3779B97F4A7C15ULL;
+  struct scratch outB;
+  int s, l, damage, okA, rc, strategy, level;
+  double t0, secs, span, spans, serialRate = 0.0;
+
+  bound  = compressBound(textSize);
+  text   = malloc(textSize + 256);
+  packed = malloc(bound);
+  outA   = malloc(textSize);
+  memset(&outB, 0, sizeof(outB));
+  if ( !text || !packed || !outA ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+
+  /* The content: an invoice's, now and then, among made-up lines */
+  used = 0;
+  while ( used < textSize ) {
+    i = benchRandom(&seed) % (4*jobCount + 4);
+    if ( i < jobCount
+         && !inflateWithZlib(zs, deflated+defOff[i], defLen[i], text+used, textSize-used, &n) )
+      used += n;
+    else if ( textSize-used > 200 ) {
+      used += sprintf((char *)text+used, "BT /F%d %d Tf %lu %lu Td (",
+                      (int)(benchRandom(&seed)%4), (int)(6 + benchRandom(&seed)%8),
+                      (unsigned long int)(benchRandom(&seed)%612),
+                      (unsigned long int)(benchRandom(&seed)%792));
+      for ( n = 1 + benchRandom(&seed)%40; n > 0; n-- )
+        text[used++] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJ0123456789$.,:"[benchRandom(&seed)%51];
+      used += sprintf((char *)text+used, ") Tj ET\n");
+    }
+    else
+      text[used++] = '\n';
+  }
+
+
+  /*==========================================================
+  Differential check, against zlib.
+  ============================================================*/
+  for ( s=0; s<=5; s++ ) {
+    for ( l=0; l<3; l++ ) {
+      level    = s<5 ? levels[l] : 0;                /* (s==5: stored, once) */
+      strategy = s<5 ? strategies[s] : Z_DEFAULT_STRATEGY;
+      if ( s==5 && l>0 )
+        break;
+      for ( damage=0; damage<3; damage++ ) {
+        packedLen = benchDeflate(text, used, packed, bound, level, strategy);
+        if ( !packedLen )
+          return 20;
+        if ( damage==1 )
+          packed[benchRandom(&seed)%packedLen] ^= 1 << benchRandom(&seed)%8;
+        if ( damage==2 )
+          packedLen = packedLen/2 + benchRandom(&seed) % (packedLen/2);
+
+        okA = !inflateWithZlib(zs, packed, packedLen, outA, textSize, &lenA);
+        if ( damage==0 && (!okA || lenA!=used || memcmp(outA,text,used)!=0) ) {
+          printf("inflate check FAILED: zlib doesn't round-trip the parallel check's stream"
+                 " (level %d, strategy %d)\n", level, strategy);
+          return 24;
+        }
+        rc = parallelInflate(tables, packed, packedLen, &outB, textSize, threads, &lenB, NULL);
+        checked++;
+        if ( rc==INFLATE_SERIAL && damage==0 ) {
+          printf("inflate check FAILED: parallelInflate() leaves a whole stream to builtin"
+                 " (level %d, strategy %d)\n", level, strategy);
+          return 24;
+        }
+        if ( rc==INFLATE_SERIAL )
+          continue;
+        parallel++;
+        if ( rc || !okA || lenA!=lenB || memcmp(outA,outB.p,lenA)!=0 ) {
+          printf("inflate check FAILED: parallelInflate() differs from zlib"
+                 " (level %d, strategy %d, %s)\n", level, strategy,
+                 damage==0 ? "whole" : damage==1 ? "a bit flipped" : "cut short");
+          return 24;
+        }
+      }
+    }
+  }
+  printf("inflate check: parallelInflate() on %d threads decodes %lu of %lu big streams"
+         " identically with zlib, and leaves the other %lu (damaged) to builtin\n",
+         threads, parallel, checked, checked-parallel);
+
+
+  /*======================================================
+  Throughput, in bytes of output per second, as for the
+  backends; and, from parallelInflate()'s span, what it
+  would be with a CPU for each of its threads.
+  ========================================================*/
+  printf("parallel inflate throughput over one %lu-byte stream, %d threads, %ld CPU%s here:\n",
+         used, threads, sysconf(_SC_NPROCESSORS_ONLN),
+         sysconf(_SC_NPROCESSORS_ONLN)==1 ? "" : "s");
+  for ( l=0; l<3; l++ ) {
+    packedLen = benchDeflate(text, used, packed, bound, levels[l], Z_DEFAULT_STRATEGY);
+    if ( !packedLen )
+      return 20;
+    for ( i=0; i<2; i++ ) {
+      rounds = 0;
+      spans  = 0.0;
+      t0 = benchSeconds();
+      do {
+        if ( i==0 )
+          (void)builtinInflate(tables, packed, packedLen, outA, textSize, &inUsed, &lenA);
+        else {
+          (void)parallelInflate(tables, packed, packedLen, &outB, textSize, threads, &lenB, &span);
+          spans += span;
+        }
+        rounds++;
+        secs = benchSeconds() - t0;
+      } while ( secs < 1.0 );
+      if ( i==0 ) {
+        serialRate = rounds*used/secs;
+        printf("  level %d, %lu bytes:  builtin %14.0f bytes/s\n", levels[l], packedLen, serialRate);
+      }
+      else
+        printf("                     parallel %14.0f bytes/s  (%.2fx builtin; %.2fx with a CPU per thread)\n",
+               rounds*used/secs, rounds*used/secs/serialRate, rounds*used/spans/serialRate);
+    }
+  }
+
+  free(text);
+  free(packed);
+  free(outA);
+  releaseScratch(&outB);
+  return 0;
+} /* benchParallelInflate() */
+
+
+unsigned long int benchDeflate(const unsigned char *in, unsigned long int inLen,
+                               unsigned char *out, unsigned long int outSize,
+                               int level, int strategy) {
+
+  /* deflate() all of in, as a zlib stream, into out; its length, or 0 (having said why). */
+
+  z_stream zc;
+  unsigned long int outLen;
+
+  memset(&zc, 0, sizeof(zc));
+  if ( deflateInit2(&zc, level, Z_DEFLATED, 15, 8, strategy) != Z_OK ) {
+    printf("rpt1bench: Can't set up deflate() for the benchmark.  Aborting.\n");
+    return 0;
+  }
+  zc.next_in   = (unsigned char *)in;
+  zc.avail_in  = inLen;
+  zc.next_out  = out;
+  zc.avail_out = outSize;
+  deflate(&zc, Z_FINISH);
+  outLen = zc.total_out;
+  deflateEnd(&zc);
+  return outLen;
+} /* benchDeflate() */
+
+
+
+int benchAlloc(void) {
+
+  /* See the Benchmarks notes above. */
+
+  static const int threadCounts[2] = { 1, 4 };
+  unsigned long int i, n, calls, needy, needyRepeats;
+  char *name;
+  int t, rc;
+  int devNull;
+
+  n = jobCount;
+  for ( i=0; i<n; i++ ) {
+    rc = addJob(jobs[i].name);
+    if ( rc )
+      return rc;
+    name = jobs[jobCount-1].name;       /* the same invoice, archive member or not */
+    jobs[jobCount-1] = jobs[i];
+    jobs[jobCount-1].name = name;
+  }
+  devNull = open("/dev/null", O_WRONLY);
+  if ( devNull<0 ) {
+    printf("rpt1bench: Can't open /dev/null.  Aborting.\n");
+    return 4;
+  }
+  showProgress = FALSE;
+
+  for ( t=0; t<2; t++ ) {
+    for ( i=0; i<jobCount; i++ ) {
+      jobs[i].text       = NULL;
+      jobs[i].textLen    = 0;
+      jobs[i].rc         = 0;
+      jobs[i].done       = FALSE;
+      jobs[i].allocCalls = 0;
+    }
+    invoiceCount = 0;
+    workerCount  = threadCounts[t];
+    rc = runParallel(devNull);
+    if ( rc )
+      return rc;
+    calls = needy = needyRepeats = 0;
+    for ( i=0; i<jobCount; i++ ) {
+      calls        += jobs[i].allocCalls;
+      needy        += jobs[i].allocCalls > 0;
+      needyRepeats += jobs[i].allocCalls > 0 && i >= n;
+    }
+    printf("alloc, %d thread%s: %lu invoices (each twice) took %lu malloc()/realloc() calls;"
+           " %lu invoices needed any, %lu of them repeats\n",
+           threadCounts[t], threadCounts[t]==1 ? "" : "s", n, calls, needy, needyRepeats);
+  }
+  close(devNull);
+  return 0;
+} /* benchAlloc() */
+
+
+
+int gatherContent(unsigned char **content, unsigned long int **contentOff,
+                  unsigned long int **contentLen) {
+
+  /*==============================================================
+  Like gatherStreams(), but decode each invoice's stream (ascii85,
+  then zlib) so that *content holds what bracketFSA() would see.
+  Return 0, or the return code for main() to give.
+  ================================================================*/
+
+  char *corpus, *deflated;
+  unsigned char *bigger;
+  unsigned long int *streamOff, *streamLen;
+  unsigned long int i, used, size, defLen, len;
+  z_stream zs;
+  int rc;
+
+  rc = gatherStreams(&corpus, &streamOff, &streamLen);
+  if ( rc )
+    return rc;
+  memset(&zs, 0, sizeof(zs));
+  *content    = NULL;
+  *contentOff = malloc(jobCount*sizeof(unsigned long int));
+  *contentLen = malloc(jobCount*sizeof(unsigned long int));
+  deflated    = NULL;
+  if ( inflateInit(&zs)!=Z_OK || !*contentOff || !*contentLen ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+  used = size = 0;
+  for ( i=0; i<jobCount && !rc; i++ ) {
+    free(deflated);
+    deflated = malloc(4*streamLen[i]+4);
+    if ( !deflated )
+      rc = 20;
+    else
+      rc = ascii85decodeAll(corpus+streamOff[i], streamLen[i], deflated, FILTERCHUNK, &defLen);
+    while ( !rc ) {
+      if ( size-used < 16*defLen+65536 ) {
+        size   = 2*size + 16*defLen + 65536;
+        bigger = realloc(*content, size);
+        if ( !bigger ) {
+          rc = 20;
+          break;
+        }
+        *content = bigger;
+      }
+      if ( !inflateWithZlib(&zs, (unsigned char *)deflated, defLen, *content+used, size-used, &len) )
+        break;
+      if ( zs.avail_out != 0 ) {
+        printf("rpt1bench: Invoice %s has bad Flate data.  Aborting.\n", jobs[i].name);
+        rc = 16;
+      }
+      else
+        size *= 2;       /* try again with more room */
+    }
+    if ( !rc ) {
+      (*contentOff)[i] = used;
+      (*contentLen)[i] = len;
+      used += len;
+    }
+  }
+  if ( rc==20 )
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+  inflateEnd(&zs);
+  free(deflated);
+  free(corpus);
+  free(streamOff);
+  free(streamLen);
+  return rc;
+} /* gatherContent() */
+
+
+
+
+void benchBracket(struct worker *w, const unsigned char *in, unsigned long int len,
+                  unsigned long int piece) {
+
+  /* Run bracketFSA() over a whole content stream, 'piece' bytes at a time, into w->text. */
+
+  unsigned long int off, n;
+  int state = START;
+
+  arenaReset(&w->arena);
+  w->text     = NULL;
+  w->textLen  = 0;
+  w->textRoom = 0;
+  (void)textRoomFor(w, TEXTCHUNK);
+  for ( off=0; off<len; off+=n ) {
+    n = len-off < piece ? len-off : piece;
+    (void)bracketFSA(w, &state, in+off, n);
+  }
+} /* benchBracket() */
+
+
+
+
+int benchScan(void) {
+
+  /* See the Benchmarks notes above. */
+
+  static const char alphabet[] = "()\\\n ab";
+  struct { const char *name; scanKernelFn fn; } kernels[3];
+  int kernelCount, k, rc;
+  struct worker *w;
+  unsigned char *content, *raw, *expect;
+  unsigned long int *contentOff, *contentLen;
+  unsigned long int i, n, total, expectLen, piece, rounds, r;
+  unsigned long long int seed = 0x9E3779B97F4A7C15ULL;
+  double t0, secs, scalarRate = 0.0;
+
+  /* Which kernels can this CPU run? */
+  kernelCount = 0;
+  kernels[kernelCount].name = "scalar";
+  kernels[kernelCount++].fn = NULL;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("sse2") ) {
+    kernels[kernelCount].name = "sse2";
+    kernels[kernelCount++].fn = scanBlockSSE2;
+  }
+  if ( __builtin_cpu_supports("avx2") ) {
+    kernels[kernelCount].name = "avx2";
+    kernels[kernelCount++].fn = scanBlockAVX2;
+  }
+#endif
+
+  rc = gatherContent(&content, &contentOff, &contentLen);
+  if ( rc )
+    return rc;
+  total = 0;
+  for ( i=0; i<jobCount; i++ )
+    total += contentLen[i];
+  w      = calloc(1, sizeof(struct worker));
+  raw    = malloc(4096);
+  expect = malloc(total+4096);
+  if ( !w || !raw || !expect ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+
+
+  /*==========================================================
+  Differential check: every kernel's text must be exactly the
+  scalar text, for the invoices' content and for random
+  streams made of nothing but the FSA's special bytes and a
+  few ordinary ones, in randomly sized pieces.
+  ============================================================*/
+  for ( r=0; r<jobCount+20000; r++ ) {
+    if ( r < jobCount ) {
+      n = contentLen[r];
+    }
+    else {
+      n = benchRandom(&seed) % 4096;
+      for ( i=0; i<n; i++ )
+        raw[i] = alphabet[benchRandom(&seed) % (sizeof(alphabet)-1)];
+    }
+    piece = r < jobCount ? CONTENTWINDOW : 1 + benchRandom(&seed) % 300;
+    scanKernel = NULL;
+    benchBracket(w, r < jobCount ? content+contentOff[r] : raw, n, piece);
+    memcpy(expect, w->text, w->textLen);
+    expectLen = w->textLen;
+    for ( k=1; k<kernelCount; k++ ) {
+      scanKernel = kernels[k].fn;
+      benchBracket(w, r < jobCount ? content+contentOff[r] : raw, n, piece);
+      if ( w->textLen!=expectLen || memcmp(w->text,expect,expectLen)!=0 ) {
+        if ( r < jobCount )
+          printf("scan check FAILED: %s differs from scalar on %s\n", kernels[k].name, jobs[r].name);
+        else
+          printf("scan check FAILED: %s differs from scalar on random stream %lu\n",
+                 kernels[k].name, r-jobCount);
+        return 24;
+      }
+    }
+  }
+  printf("scan check: %lu invoice streams and 20000 random streams give the same text with",
+         jobCount);
+  for ( k=0; k<kernelCount; k++ )
+    printf(" %s", kernels[k].name);
+  printf("\n");
+
+
+  /*======================================================
+  Throughput, in bytes of content per second, fed to the
+  FSA a window-full at a time the way decodeContentStream()
+  does.  Each kernel gets at least a second's worth.
+  ========================================================*/
+  printf("scan throughput over %lu bytes of content in %lu invoices:\n", total, jobCount);
+  for ( k=0; k<kernelCount; k++ ) {
+    scanKernel = kernels[k].fn;
+    rounds = 0;
+    t0 = benchSeconds();
+    do {
+      for ( i=0; i<jobCount; i++ )
+        benchBracket(w, content+contentOff[i], contentLen[i], CONTENTWINDOW);
+      rounds++;
+      secs = benchSeconds() - t0;
+    } while ( secs < 1.0 );
+    if ( k==0 )
+      scalarRate = rounds*total/secs;
+    printf("  %-8s %14.0f bytes/s  (%.2fx scalar)\n", kernels[k].name,
+           rounds*total/secs, rounds*total/secs/scalarRate);
+  }
+
+  chooseScanKernel();
+  printf("chooseScanKernel() picks %s on this CPU\n", scanKernelName);
+  releaseWorker(w);
+  free(w);
+  free(content);
+  free(contentOff);
+  free(contentLen);
+  free(raw);
+  free(expect);
+  return 0;
+} /* benchScan() */
+
+
+
+
+void benchTokenize(struct worker *w, const unsigned char *in, unsigned long int len,
+                   unsigned long int piece) {
+
+  /* Run tokenizeContent() over a whole content stream, 'piece' bytes at a time, into w->runs. */
+
+  unsigned long int off, n;
+
+  arenaReset(&w->arena);
+  w->text     = NULL;
+  w->textLen  = 0;
+  w->textRoom = 0;
+  (void)textRoomFor(w, TEXTCHUNK);
+  tokenizerStart(w);
+  for ( off=0; off<len; off+=n ) {
+    n = len-off < piece ? len-off : piece;
+    (void)tokenizeContent(w, in+off, n);
+  }
+  (void)tokenizeContent(w, (const unsigned char *)"\n", 1);
+} /* benchTokenize() */
+
+
+
+
+unsigned long int makeContent(unsigned long long int *seed, char *out, int runs,
+                              struct textRun *expect, unsigned char *text) {
+
+  /*==============================================================
+  For the random checks: write into 'out' a content stream that
+  shows 'runs' runs of random bytes at random places, spelling
+  the text every way a content stream can and mixing in things
+  (comments, marked-content dictionaries, inline images) whose
+  brackets aren't text.  The runs it shows go into expect[],
+  their text back to back into 'text'.  Coordinates are all
+  multiples of 0.25, so they come back exact.  'out' needs 2K a
+  run and 'text' 256 bytes.  Returns the length of the stream.
+  ================================================================*/
+
+  static const char named[] = "nrtbf", namedAs[] = "\n\r\t\b\f";
+  unsigned long int len = 0, t = 0;
+  int r, piece, pieces, n, i, c, how, array;
+  double sx, sy, dx, dy, lead;
+
+  for ( r=0; r<runs; r++ ) {
+    expect[r].x   = (double)(benchRandom(seed)%4000) / 4.0;
+    expect[r].y   = (double)(benchRandom(seed)%4000) / 4.0;
+    expect[r].off = t;
+    if ( benchRandom(seed)%4 == 0 )
+      len += sprintf(out+len, "%% a comment, (not text\\) <41>\n");
+    if ( benchRandom(seed)%4 == 0 )
+      len += sprintf(out+len, "/Span <</ActualText (not text) /Alt <4142> /TJ /Tm>> BDC EMC\n");
+    if ( benchRandom(seed)%8 == 0 ) {
+      len += sprintf(out+len, "BI /W 4 /H 1 /BPC 8 /CS /G ID ");
+      for ( i=0; i<4; i++ )
+        out[len++] = "()<>\\E "[benchRandom(seed)%7];
+      len += sprintf(out+len, "\nEI\n");
+    }
+
+    how = benchRandom(seed)%5;
+    switch ( how ) {
+      case 0:  len += sprintf(out+len, "BT /F1 9 Tf 1 0 0 1 %.2f %.2f Tm\n",
+                              expect[r].x, expect[r].y);
+               break;
+      case 1:  len += sprintf(out+len, "BT %.2f %.2f Td\n", expect[r].x, expect[r].y);
+               break;
+      case 2:  sx = 1 + benchRandom(seed)%3;            /* moved again by cm */
+               sy = 1 + benchRandom(seed)%3;
+               dx = (double)(benchRandom(seed)%400) / 4.0;
+               dy = (double)(benchRandom(seed)%400) / 4.0;
+               len += sprintf(out+len, "q %.0f 0 0 %.0f %.2f %.2f cm BT %.2f %.2f Td\n",
+                              sx, sy, dx, dy, expect[r].x, expect[r].y);
+               expect[r].x = sx*expect[r].x + dx;
+               expect[r].y = sy*expect[r].y + dy;
+               break;
+      case 3:  dx = (double)(benchRandom(seed)%400) / 4.0;    /* Td then TD */
+               dy = (double)(benchRandom(seed)%400) / 4.0;
+               len += sprintf(out+len, "BT %.2f %.2f Td %.2f %.2f TD\n",
+                              expect[r].x - dx, expect[r].y - dy, dx, dy);
+               break;
+      default: lead = (double)(benchRandom(seed)%80) / 4.0;  /* the first show is ' or T* */
+               len += sprintf(out+len, "BT %.2f TL %.2f %.2f Td\n",
+                              lead, expect[r].x, expect[r].y + lead);
+               break;
+    }
+
+    pieces = 1 + benchRandom(seed)%3;
+    array  = benchRandom(seed)%2;
+    if ( array )
+      len += sprintf(out+len, how==4 ? "T* [" : "[");
+    for ( piece=0; piece<pieces; piece++ ) {
+      n = (piece==0) + benchRandom(seed)%60;    /* an empty first piece would show nothing */
+      if ( benchRandom(seed)%3 == 0 ) {         /* <hex> */
+        out[len++] = '<';
+        for ( i=0; i<n; i++ ) {
+          c = benchRandom(seed)%256;
+          text[t++] = c;
+          len += sprintf(out+len, benchRandom(seed)%2 ? "%02x" : "%02X", c);
+          if ( benchRandom(seed)%8 == 0 )
+            out[len++] = ' ';
+        }
+        if ( benchRandom(seed)%4 == 0 ) {       /* an odd digit out: a 0 follows it */
+          c = benchRandom(seed)%16;
+          len += sprintf(out+len, "%x", c);
+          text[t++] = c << 4;
+        }
+        out[len++] = '>';
+      }
+      else {                                    /* (literal) */
+        out[len++] = '(';
+        for ( i=0; i<n; i++ ) {
+          c = benchRandom(seed)%256;
+          switch ( benchRandom(seed)%8 ) {
+            case 0:  len += sprintf(out+len, "(%c)", 'a' + c%26);   /* balanced, so unescaped */
+                     text[t++] = '(';
+                     text[t++] = 'a' + c%26;
+                     text[t++] = ')';
+                     continue;
+            case 1:  if ( c < 64 ) {            /* \d or \dd, then something not a digit */
+                       len += sprintf(out+len, "\\%oz", c);
+                       text[t++] = c;
+                       text[t++] = 'z';
+                     }
+                     else {
+                       len += sprintf(out+len, "\\%03o", c);
+                       text[t++] = c;
+                     }
+                     continue;
+            case 2:  c = benchRandom(seed)%5;
+                     out[len++] = '\\';
+                     out[len++] = named[c];
+                     text[t++]  = namedAs[c];
+                     continue;
+            case 3:  len += sprintf(out+len, benchRandom(seed)%2 ? "\\\n" : "\\\r\n");
+                     break;             /* a line continuation, then the byte */
+          }
+          if ( c=='\r' ) {              /* a bare \r would read as a newline */
+            len += sprintf(out+len, "\\r");
+            text[t++] = c;
+            continue;
+          }
+          if ( c=='(' || c==')' || c=='\\' )
+            out[len++] = '\\';
+          out[len++] = c;
+          text[t++]  = c;
+        }
+        out[len++] = ')';
+      }
+      if ( array ) {
+        if ( benchRandom(seed)%2 )
+          len += sprintf(out+len, " -%d ", (int)(benchRandom(seed)%300));
+      }
+      else
+        len += sprintf(out+len, (how==4 && piece==0) ? "'\n" : " Tj\n");
+    }
+    if ( array )
+      len += sprintf(out+len, "] TJ\n");
+    len += sprintf(out+len, how==2 ? "ET Q\n" : "ET\n");
+    expect[r].len = t - expect[r].off;
+  }
+  return len;
+} /* makeContent() */
+
+
+
+
+int benchTokens(void) {
+
+  /* See the Benchmarks notes above. */
+
+  struct worker *w;
+  struct textRun *expect, *got;
+  unsigned char *content, *text, *fsaText;
+  char *raw;
+  unsigned long int *contentOff, *contentLen;
+  unsigned long int i, j, total, rawLen, fsaLen, rounds;
+  int k;
+  unsigned long long int seed = 0x9E3779B97F4A7C15ULL;
+  int r, runs, rc;
+  double t0, secs, fsaRate = 0.0;
+
+  rc = gatherContent(&content, &contentOff, &contentLen);
+  if ( rc )
+    return rc;
+  total = 0;
+  for ( i=0; i<jobCount; i++ )
+    total += contentLen[i];
+  w       = calloc(1, sizeof(struct worker));
+  raw     = malloc(MAXCHECKRUNS*2048);
+  text    = malloc(MAXCHECKRUNS*256);
+  expect  = malloc(MAXCHECKRUNS*sizeof(struct textRun));
+  fsaText = malloc(total+1);
+  if ( !w || !raw || !text || !expect || !fsaText ) {
+    printf("rpt1bench: No memory for the benchmark.  Aborting.\n");
+    return 20;
+  }
+
+
+  /*==========================================================
+  Round trip: random streams, whose runs are known, fed to the
+  tokenizer in randomly sized pieces must give back exactly
+  those runs: the same places and the same bytes.
+  ============================================================*/
+  for ( k=0; k<20000; k++ ) {
+    runs   = 1 + benchRandom(&seed)%MAXCHECKRUNS;
+    rawLen = makeContent(&seed, raw, runs, expect, text);
+    benchTokenize(w, (unsigned char *)raw, rawLen, 1 + benchRandom(&seed)%300);
+    got = (struct textRun *)w->runs.p;
+    for ( r=0; r<runs; r++ )
+      if ( (unsigned long int)r >= w->runCount
+           || got[r].x!=expect[r].x || got[r].y!=expect[r].y || got[r].len!=expect[r].len
+           || memcmp(w->text+got[r].off, text+expect[r].off, expect[r].len)!=0 )
+        break;
+    if ( r<runs || w->runCount!=(unsigned long int)runs ) {
+      printf("tokens check FAILED: random stream %d, run %d of %d (%lu found)\n",
+             k, r, runs, w->runCount);
+      return 24;
+    }
+  }
+  printf("tokens check: 20000 random streams give back the runs they were made from\n");
+
+
+  /*==========================================================
+  The invoices: the runs' text, end to end, must be the FSA's
+  text without the newlines it puts after each string.  (The
+  invoices have no escapes or hex strings, which the FSA
+  would leave as they are.)
+  ============================================================*/
+  for ( i=0; i<jobCount; i++ ) {
+    benchBracket(w, content+contentOff[i], contentLen[i], CONTENTWINDOW);
+    for ( fsaLen=0, j=0; j<w->textLen; j++ )
+      if ( w->text[j]!='\n' )
+        fsaText[fsaLen++] = w->text[j];
+    benchTokenize(w, content+contentOff[i], contentLen[i], CONTENTWINDOW);
+    got = (struct textRun *)w->runs.p;
+    for ( rawLen=0, j=0; j<w->runCount; j++ ) {
+      if ( rawLen+got[j].len > fsaLen
+           || memcmp(fsaText+rawLen, w->text+got[j].off, got[j].len)!=0 )
+        break;
+      rawLen += got[j].len;
+    }
+    if ( j<w->runCount || rawLen!=fsaLen ) {
+      printf("tokens check FAILED: the runs' text isn't the FSA's text on %s\n", jobs[i].name);
+      return 24;
+    }
+  }
+  printf("tokens check: %lu invoice streams give the same text as bracketFSA()\n", jobCount);
+
+
+  /*======================================================
+  Throughput, in bytes of content per second, a window-
+  full at a time, of the FSA (with the scan kernel it
+  would use) and of the tokenizer.
+  ========================================================*/
+  printf("tokens throughput over %lu bytes of content in %lu invoices:\n", total, jobCount);
+  for ( r=0; r<2; r++ ) {
+    rounds = 0;
+    t0 = benchSeconds();
+    do {
+      for ( i=0; i<jobCount; i++ )
+        if ( r==0 )
+          benchBracket(w, content+contentOff[i], contentLen[i], CONTENTWINDOW);
+        else
+          benchTokenize(w, content+contentOff[i], contentLen[i], CONTENTWINDOW);
+      rounds++;
+      secs = benchSeconds() - t0;
+    } while ( secs < 1.0 );
+    if ( r==0 )
+      fsaRate = rounds*total/secs;
+    printf("  %-18s %14.0f bytes/s  (%.2fx bracketFSA)\n",
+           r==0 ? "bracketFSA" : "tokenizeContent", rounds*total/secs, rounds*total/secs/fsaRate);
+  }
+
+  releaseWorker(w);
+  free(w);
+  free(content);
+  free(contentOff);
+  free(contentLen);
+  free(raw);
+  free(text);
+  free(expect);
+  free(fsaText);
+  return 0;
+} /* benchTokens() */
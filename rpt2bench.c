@@ -0,0 +1,181 @@
+/*====================================================================
+rpt2bench:  Time the search for report2's fields in report1
+
+Copyright (C) 2021  Larry Anta
+
+
+This is a tool for working on rpt2pgm, not part of processing your
+invoices; the script doesn't use it.  Build it from the same directory
+as rpt2pgm.c (it compiles rpt2pgm.c in, see below):
+
+    gcc -O2 -pthread -o rpt2bench rpt2bench.c
+
+or 'make rpt2bench'.
+
+Usage:
+
+    rpt2bench report1Filename
+
+It times the search for report2's fields over report1, and over report1
+with each invoice repeated up to 32 times (see benchLabels()), and
+writes nothing.
+======================================================================*/
+
+
+
+
+/*====================================================================
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+======================================================================*/
+
+
+/* All of rpt2pgm.c, with its main() renamed, so that what's timed is the code rpt2pgm runs. */
+#define main rpt2pgmMain
+#include "rpt2pgm.c"
+#undef main
+
+void findLabelsStrstr(const char *startp, const char *endp, const char *at[LABELS]);
+int benchLabels(const char *report1, unsigned long int len);
+
+
+
+
+/* Mainline */
+int main(int argc, char *argv[]) {
+  struct report1 report1;
+  int rc;
+
+  if ( argc != 2 ) {
+    printf("Usage: %s inputFilename\n", argv[0]);
+    return 17;
+  }
+  if ( strlen(argv[1]) > MAXFNAMELEN ) {
+    puts("Input file name too long.  Aborting.");
+    return 18;
+  }
+  buildLabels();
+  rc = loadReport1(argv[1], &report1);
+  if ( rc )
+    return rc;
+  rc = benchLabels(report1.text, report1.len);
+  unloadReport1(&report1);
+  return rc;
+}
+
+
+
+
+void findLabelsStrstr(const char *startp, const char *endp, const char *at[LABELS]) {
+  /*==========================================================================
+  What findLabels() replaced: a strstr() per label, from the start of the
+  invoice, which doesn't stop at its end.  (For benchLabels() to compare.)
+  ============================================================================*/
+
+  int i;
+
+  for ( i=0; i<LABELS; i++ ) {
+    at[i] = strstr(startp, labels[i].text);
+    if ( at[i] && at[i]>endp )
+      at[i] = NULL;
+  }
+}
+
+
+
+
+int benchLabels(const char *report1, unsigned long int len) {
+  /*==========================================================================
+  For rpt2bench: time the search for report2's fields, both ways,
+  over report1, and over report1 with every invoice in it 2, 4, 8, 16 and
+  32 times over (each copy next to the one before, so that the invoices
+  that lack a label, such as those from after March 2021 without a tax
+  point date, stay together at the end, as in a real year).  The two ways
+  must first agree on every invoice.  findLabels() should take the same
+  time per byte however long report1 is; findLabelsStrstr() takes longer
+  per byte the longer it is, since the search for a label that an invoice
+  doesn't have runs on until some later invoice has it, or to the end.
+  ============================================================================*/
+
+  struct timespec t0, t1;
+  const char *atA[LABELS], *atB[LABELS];
+  struct invoice *orig, *spans;
+  const char *next;
+  char *text;
+  unsigned long int copies, origCount, invCount, used, i, k, rounds;
+  double secs[2];
+  int way, j, rc;
+
+  rc = findInvoices(report1, len, 1, &orig, &origCount);
+  for ( copies=1; copies<=32 && !rc; copies*=2 ) {
+
+    /* report1, with each of its invoices 'copies' times */
+    text = malloc(copies*len+1);
+    if ( !text ) {
+      printf("malloc() failed to allocate %lu bytes\nAborting.", copies*len+1);
+      free(orig);
+      return 3;
+    }
+    used = orig[0].firstByte - report1;
+    memcpy(text, report1, used);
+    for ( i=0; i<origCount; i++ ) {
+      next = ( i+1<origCount ) ? orig[i+1].firstByte : report1+len;
+      for ( k=0; k<copies; k++ ) {
+        memcpy(text+used, orig[i].firstByte, next-orig[i].firstByte);
+        used += next-orig[i].firstByte;
+      }
+    }
+    text[used] = '\0';
+    rc = findInvoices(text, used, 1, &spans, &invCount);
+
+    for ( i=0; i<invCount && !rc; i++ ) {
+      findLabels(spans[i].firstByte, spans[i].lastByte, atA);
+      findLabelsStrstr(spans[i].firstByte, spans[i].lastByte, atB);
+      for ( j=0; j<LABELS; j++ ) {
+        if ( atA[j]!=atB[j] ) {
+          printf("The field searches disagree on invoice %lu's label %d.  Aborting.\n", i+1, j);
+          rc = 22;
+          break;
+        }
+      }
+    }
+
+    for ( way=0; way<2 && !rc; way++ ) {
+      rounds = 0;
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      do {
+        for ( i=0; i<invCount; i++ ) {
+          if ( way==0 )
+            findLabelsStrstr(spans[i].firstByte, spans[i].lastByte, atB);
+          else
+            findLabels(spans[i].firstByte, spans[i].lastByte, atA);
+        }
+        rounds++;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        secs[way] = (t1.tv_sec-t0.tv_sec) + (t1.tv_nsec-t0.tv_nsec)/1e9;
+      } while ( secs[way] < 0.5 );
+      secs[way] /= rounds;
+    }
+    if ( !rc )
+      printf("x%lu: %9lu bytes, %6lu invoices:  strstr() %8.2f ns/byte,  findLabels() %5.2f ns/byte\n",
+             copies, used, invCount, secs[0]*1e9/used, secs[1]*1e9/used);
+    free(text);
+    free(spans);
+  }
+  free(orig);
+  return rc;
+}
+
+
+
+
@@ -0,0 +1,388 @@
+/*====================================================================
+rpt2fields:  Report2's fields, and how they're found in report1
+
+Copyright (C) 2021  Larry Anta
+
+
+This isn't a program.  It's the part of rpt2pgm that finds the labels
+in an invoice's text and makes the invoice's CSV row from what follows
+them, and it's compiled into both programs that do that: rpt2pgm,
+reading report1 back in, and rpt1pgm, in -csv mode, as each invoice's
+text is extracted.  Each of them has
+
+    #include "rpt2fields.c"
+
+after its own #includes, so it has to be in the same directory as
+rpt1pgm.c and rpt2pgm.c when they're compiled.  The rules for a field
+are here and nowhere else: the labels[] table, and fieldsRow().
+======================================================================*/
+
+
+
+
+/*====================================================================
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+======================================================================*/
+
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/*======================================================
+Set aside this many bytes for the restaurant name, three
+of which are for the enclosing double quotes and the nul
+byte at the end.
+========================================================*/
+#define RESTAURANTMAX 53
+
+
+/* An invoice number (and its nul) is cut short to fit this many bytes: */
+#define INVNUMMAX 30
+
+
+/* A CSV row is never longer than its fields' buffers (see fieldsRow()) put together. */
+#define MAXROW 256
+
+
+/*=====================================================================
+The labels that introduce report2's fields in an invoice's text, each
+with the newline that starts its line.  Rather than look for each one
+with strstr(), from the start of the invoice, findLabels() looks for
+all of them at once, in one pass over the invoice and no further,
+driven by this table (see buildLabels()).  A label that's missing then
+costs nothing more than one that isn't.
+
+With each label, what fieldsRow() does with it:
+  ends      what ends its field's value, after the label: each byte in
+            turn ("\n\n" is the end of the line after the label's line,
+            "" means the label is all that's needed)
+  missing   fieldsRow()'s return code when it isn't there, or 0 if an
+            invoice needn't have it
+rpt1pgm's -lazy mode (see fieldsSeen() in rpt1pgm.c) uses the same two
+columns to tell when an invoice's text has all of its row.
+=======================================================================*/
+enum { INVOICE_NUMBER, INVOICE_DATE, DELIVERY_SERVICE, UBER_PORTIER,
+       GST_NUMBER, TOTAL_NET, GROSS_AMOUNT, TOTAL_HST, LABELS };
+
+const struct {
+  const char *text;
+  const char *ends;
+  int         missing;
+} labels[LABELS] = {
+  { "\nInvoice Number:  ",          "\n",   10 },
+  { "\nInvoice Date:  ",            "\n",   11 },
+  { "\nDelivery service",           "",     0  },
+  { "\nUber Portier B.V.",          "\n\n", 12 },
+  { "\nGST Registration Number: ",  "\n",   13 },
+  { "\nTotal Net \n",               " ",    14 },
+  { "\nGross Amount \n",            " ",    15 },
+  { "\nTotal HST Amount \n",        " ",    0  }
+};
+int labelLen[LABELS];
+unsigned int labelsAfter[256];  /* the labels whose newline this byte comes after (a bit each) */
+
+
+/* The field searches */
+void buildLabels(void);
+void findLabels(const char *startp, const char *endp, const char *at[LABELS]);
+const unsigned char *labelLine(const unsigned char *x, const unsigned char *end,
+                               unsigned int wanted);
+int fieldsRow(const char *startp, const char *endp, const char *textEnd,
+              char *row, int *rowLen, char *invNum);
+const char *copyField(char *field, int room, const char *x, const char *end, int stop);
+
+
+
+
+int fieldsRow(const char *startp, const char *endp, const char *textEnd,
+              char *row, int *rowLen, char *invNum) {
+  /*==========================================================================
+  Make the CSV row (with its newline, *rowLen bytes, less than MAXROW) for
+  the invoice whose text runs from startp to endp inclusive.  No field is
+  read past textEnd, and a field too long for its column is cut short.
+  invNum (INVNUMMAX bytes) gets its invoice number, for the caller's message.
+  Return 0, or the code for the field it's missing (labels[].missing).
+  ============================================================================*/
+
+  const char *x;
+  const char *at[LABELS]; /* where in the invoice each label is, or NULL (see findLabels()) */
+  char *w;
+  char invDate[20];
+  char taxPointDate[20];
+  char restaurantName[RESTAURANTMAX];
+  char gstNumber[20];
+  char netAmt[10];
+  char grossAmt[10];
+  char hstAmt[10];
+
+  *invNum = '\0';
+  findLabels(startp, endp, at);
+
+
+  /*===============================================================================
+  Every invoice should have an invoice number.  It's on a line that begins with the
+  text 'Invoice Number:  '.  (Note the two spaces after the colon.)  Scoop up the
+  rest of the line.
+  =================================================================================*/
+  x=at[INVOICE_NUMBER];
+  if ( !x )
+    return labels[INVOICE_NUMBER].missing;
+  copyField(invNum, INVNUMMAX, x+labelLen[INVOICE_NUMBER], textEnd, labels[INVOICE_NUMBER].ends[0]);
+
+
+  /*====================================================================
+  Do the same for the invoice date but enclose the date in double quotes
+  since it contains a comma.  (CSV-file rules require this.)
+  ======================================================================*/
+  x=at[INVOICE_DATE];
+  if ( !x )
+    return labels[INVOICE_DATE].missing;
+  invDate[0]='\"';
+  copyField(invDate+1, sizeof(invDate)-2, x+labelLen[INVOICE_DATE], textEnd,
+            labels[INVOICE_DATE].ends[0]);
+  strcat(invDate,"\"");
+
+
+  /*===================================================================
+  The tax point date is a little tricky.  It's not always present.
+
+  Sometime around March 15, 2021, Uber seems to have stopped putting
+  tax point dates in trip invoices.  Even an invoice that contains
+  the text 'Tax Point Date' doesn't necessarily have one.  (All
+  invoices still contain an invoice date though.)
+
+  I've noticed that invoices that actually do contain a tax point date
+  also have a line that starts with 'Delivery service'.  In that case,
+  the tax point date is the entire line immediately above the
+  'Delivery service' line.
+
+  As with the invoice date, the tax point date contains a comma, so we
+  have to enclose it in double quotes.
+
+  If an invoice does NOT contain a tax point date, we set the tax point
+  date field to 'notSpecified' in the CSV file.
+  =====================================================================*/
+  strcpy(taxPointDate,"notSpecified");
+  x=at[DELIVERY_SERVICE];
+  if ( x ) {
+    while ( x>startp && x[-1]!='\n' )   /* Back up to the start of the line above... */
+      x--;
+    taxPointDate[0]='\"';
+    copyField(taxPointDate+1, sizeof(taxPointDate)-2, x, textEnd, '\n');  /* ...and capture it. */
+    w = taxPointDate + strlen(taxPointDate) - 1;
+    *w++='\"';  /* There's always a blank at the end of the tax point date.  Replace it. */
+    *w='\0';
+  }
+
+
+  /*==========================================================
+  Every invoice has a restaurant name.
+
+  It's on the line following the line that starts with the
+  text 'Uber Portier B.V.'.
+
+  It's conceivable that a restaurant's name contains a comma,
+  so, to be safe, we always enclose the name in double quotes.
+  We also truncate the restaurant's name if it's too long.
+
+  Pray that we never see a restaurant name with a double
+  quote in it.  (We would need to modify this code to double
+  each of those double quotes.)
+  ============================================================*/
+  x=at[UBER_PORTIER];
+  if ( !x )
+    return labels[UBER_PORTIER].missing;
+  x = memchr(x+1, labels[UBER_PORTIER].ends[0], textEnd-(x+1));   /* Ignore the rest of this line. */
+  restaurantName[0]='\"';
+  copyField(restaurantName+1, RESTAURANTMAX-2, x ? x+1 : textEnd, textEnd,
+            labels[UBER_PORTIER].ends[1]);
+  strcat(restaurantName,"\"");
+
+
+  /*=============================================================
+  Every invoice has two GST registration numbers, one for the
+  restaurant and one for the driver.
+
+  The restaurant's GST number appears first and is on a line that
+  starts with the text 'GST Registration Number: '.
+  ===============================================================*/
+  x=at[GST_NUMBER];
+  if ( !x )
+    return labels[GST_NUMBER].missing;
+  copyField(gstNumber, sizeof(gstNumber), x+labelLen[GST_NUMBER], textEnd,
+            labels[GST_NUMBER].ends[0]);
+
+
+  /*=======================================================
+  Every invoice has a net amount.  It's the value found on
+  the line following the line that contains only this text:
+  'Total Net '.
+
+  The value starts at the first byte of the line and is
+  followed by at least one blank.
+  =========================================================*/
+  x=at[TOTAL_NET];
+  if ( !x )
+    return labels[TOTAL_NET].missing;
+  copyField(netAmt, sizeof(netAmt), x+labelLen[TOTAL_NET], textEnd, labels[TOTAL_NET].ends[0]);
+
+
+  /*========================================================
+  Every invoice has a gross amount.  It's the value found on
+  the line following the line that contains only this text:
+  'Gross Amount '.
+
+  The value starts at the first byte of the line and is
+  followed by at least one blank.
+  ==========================================================*/
+  x=at[GROSS_AMOUNT];
+  if ( !x )
+    return labels[GROSS_AMOUNT].missing;
+  copyField(grossAmt, sizeof(grossAmt), x+labelLen[GROSS_AMOUNT], textEnd,
+            labels[GROSS_AMOUNT].ends[0]);
+
+
+  /*=========================================================
+  Not all invoices contain an HST amount.  If the invoice has
+  a line that contains only the text 'Total HST Amount ',
+  then the HST amount is on the line following that one.
+
+  The HST starts at the first byte and is followed by at
+  least one blank.
+
+  If the invoice does not have an HST amount, we set the
+  HST value to '0.00'.
+  ===========================================================*/
+  strcpy(hstAmt,"0.00");
+  x=at[TOTAL_HST];
+  if ( x )
+    copyField(hstAmt, sizeof(hstAmt), x+labelLen[TOTAL_HST], textEnd, labels[TOTAL_HST].ends[0]);
+
+
+  /* We have all the fields we need.  Make the invoice's row of the CSV file. */
+  *rowLen = sprintf(row, "%s,%s,%s,%s,%s,%s,%s,%s\n", invNum,invDate,taxPointDate,
+                    restaurantName,gstNumber,netAmt,hstAmt,grossAmt);
+  return 0;
+}
+
+
+
+
+const char *copyField(char *field, int room, const char *x, const char *end, int stop) {
+  /*==========================================================================
+  Copy a field's bytes, from x up to the first 'stop' byte (or end), into
+  'field' and nul-terminate it, cutting it short if it needs more than 'room'
+  bytes.  Return where it ended.
+  ============================================================================*/
+
+  while ( x<end && *x!=stop && room>1 ) {
+    *field++ = *x++;
+    room--;
+  }
+  *field = '\0';
+  return x;
+}
+
+
+
+
+void buildLabels(void) {
+  /*==========================================================================
+  Fill in what findLabels() needs from the labels[] table: each label's
+  length, and for each byte, which labels have it just after their newline.
+  ============================================================================*/
+
+  int i;
+
+  memset(labelsAfter, 0, sizeof(labelsAfter));
+  for ( i=0; i<LABELS; i++ ) {
+    labelLen[i] = strlen(labels[i].text);
+    labelsAfter[(unsigned char)labels[i].text[1]] |= 1u << i;
+  }
+}
+
+
+
+
+void findLabels(const char *startp, const char *endp, const char *at[LABELS]) {
+  /*==========================================================================
+  Find where the first of each label is in the invoice from startp to endp,
+  or NULL if it isn't there, in one pass.  A label may end on the newline
+  just after endp (that's the newline before the next row of equal signs),
+  so that's where the pass stops, unless every label has been found sooner.
+
+  Every label starts a line, so the pass goes from newline to newline (see
+  labelLine()), and only stops at one whose next byte is the one after the
+  newline of a label it's still looking for.  There, each such label is
+  compared with what follows.  A line may start more than one label, and a
+  label may end on the newline that starts the next one, so the pass goes
+  on from the very next byte.
+  ============================================================================*/
+
+  const unsigned char *x, *end = (const unsigned char *)endp+2;
+  unsigned int wanted = (1u << LABELS) - 1;
+  unsigned int maybe;
+  int i;
+
+  for ( i=0; i<LABELS; i++ )
+    at[i] = NULL;
+  for ( x=(const unsigned char *)startp; wanted && (x=labelLine(x, end, wanted)); x++ ) {
+    for ( maybe = labelsAfter[x[1]] & wanted; maybe; maybe &= maybe-1 ) {
+      i = __builtin_ctz(maybe);
+      if ( end-x >= labelLen[i] && memcmp(x, labels[i].text, labelLen[i])==0 ) {
+        at[i]   = (const char *)x;
+        wanted &= ~(1u << i);
+      }
+    }
+  }
+}
+
+
+
+
+const unsigned char *labelLine(const unsigned char *x, const unsigned char *end,
+                               unsigned int wanted) {
+  /*==========================================================================
+  For findLabels(): the first newline from x on (but before end) whose next
+  byte comes after the newline of one of the labels still wanted, or NULL.
+  Lines are short, so rather than memchr() from one newline to the next,
+  this makes a mask of the newlines in 64 bytes at a time (with SSE2, which
+  every x86-64 CPU has) and looks only at the byte after each of them.
+  Elsewhere, and for the last few bytes, it goes a byte at a time.
+  ============================================================================*/
+
+#if defined(__SSE2__)
+  __m128i nl = _mm_set1_epi8('\n');
+  unsigned long long int m;
+  int k;
+
+  for ( ; end-x >= 65; x+=64 ) {
+    m = 0;
+    for ( k=0; k<4; k++ )
+      m |= (unsigned long long int)(unsigned int)
+           _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(x+16*k)), nl)) << 16*k;
+    for ( ; m; m&=m-1 ) {
+      if ( labelsAfter[x[__builtin_ctzll(m)+1]] & wanted )
+        return x + __builtin_ctzll(m);
+    }
+  }
+#endif
+  for ( ; x+1<end; x++ ) {
+    if ( *x=='\n' && (labelsAfter[x[1]] & wanted) )
+      return x;
+  }
+  return NULL;
+}
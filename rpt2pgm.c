@@ -7,11 +7,25 @@ Copyright (C) 2021  Larry Anta
 
 You shouldn't have to modify anything in this program.  You can
 compile it if you want, or let the invoking script compile it
-automatically.
+automatically.  It includes rpt2fields.c, which has to be in the
+same directory.
 
 Sample build:
 
-    gcc -o rpt2pgm rpt2pgm.c
+    gcc -O2 -pthread -o rpt2pgm rpt2pgm.c
+
+Usage:
+
+    rpt2pgm [-t threads] report1Filename csvFilename
+    rpt2pgm -stream {report1Filename | -} csvFilename
+
+The first form makes report2, a CSV file, from report1, on as many
+threads as there are processors unless -t says otherwise.  The second
+does the same on one thread, reading report1 a block at a time, so it
+needs only as much memory as the biggest invoice, however big report1
+is; a report1 of '-' is stdin (and is always read this way), as in
+'rpt1pgm -a - ... | rpt2pgm - report2'.  (rpt2bench.c, a separate
+program built from this file, times the search for report2's fields.)
 ======================================================================*/
 
 
@@ -33,13 +47,23 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 ======================================================================*/
 
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define TRUE 1
 #define FALSE 0
 
+/* The labels[] table, the field rules and the field searches, shared with rpt1pgm's -csv */
+#include "rpt2fields.c"
+
 
 /*=========================================================================
 Return
@@ -49,7 +73,7 @@ Return
    1   -could not open the raw text file
    2   -too many invoices
    3   -not enough memory to hold all trip invoices (malloc failure)
-   4   -byte count mismatch between disk and in-memory copy of text file
+   4   -error reading the raw text file (one that can't be mapped)
    5   -could not find first byte of first invoice in memory
    6   -could not find last byte of first invoice in memory
    7   -could not find last byte of an invoice in memory
@@ -65,46 +89,124 @@ Return
   17   -invalid command line arguments
   18   -input file name too long
   19   -output file name too long
-  20   -no memory for first linked-list node
-  21   -no memory for new linked-list node
+  20   -no memory for the list of invoices
+  21   -no memory to make the list of invoices longer
+  22   -the two field searches disagree (rpt2bench only)
+  23   -no memory for the extraction threads
+  24   -no memory for the CSV file's rows
+  25   -no memory for an invoice (-stream only)
+  26   -error reading report1 (-stream only)
 =========================================================================*/
 
 
-/*===================================================
-How big is an unsigned long int?  Since we don't know
-where this program will be compiled, let's assume the
-worst case: that an unsigned long int is only 32 bits
-wide.  This gives us a usable range of from 0 to
-+4,294,967,295.
-=====================================================*/
-#define MAX_SIZE 4294967295
+/* The input and output file names are allowed to be this long: */
+#define MAXFNAMELEN 100
 
 
-/*======================================================
-Set aside this many bytes for the restaurant name, three
-of which are for the enclosing double quotes and the nul
-byte at the end.
-========================================================*/
-#define RESTAURANTMAX 53
+/* Use no more than this many threads, however many processors there are: */
+#define MAXTHREADS 256
 
 
-/* The input and output file names are allowed to be this long: */
-#define MAXFNAMELEN 100
+/* -stream reads report1 this many bytes at a time: */
+#define STREAMBLOCK (1UL << 20)
+
+
+/*=====================================================================
+report1, in memory (see loadReport1()): len bytes at text, mapped (in
+a reservation of mapLen bytes at map), or read into buf.  There's no
+'\0' after it.
+=======================================================================*/
+struct report1 {
+  const char        *text;
+  unsigned long int  len;
+  int                mapped;
+  char              *map;
+  unsigned long int  mapLen;
+  char              *buf;
+};
+
+
+/* Map a big report1 at a boundary this big, where huge pages may back it: */
+#define HUGEPAGE (2UL << 20)
+
+/* Read a report1 that can't be mapped this many bytes at a time, at first: */
+#define READCHUNK 65536
 
 
 /*==============================================
-A linked-list.  Each node will hold the starting
-and ending addresses of one invoice.
+An array, one entry per invoice, in order.  Each
+holds the starting and ending addresses of one
+invoice (see findInvoices()).
 ================================================*/
-struct invoices {
-  char            *firstByte;
-  char            *lastByte;
-  struct invoices *next;
+struct invoice {
+  const char *firstByte;
+  const char *lastByte;
+};
+
+
+/*=====================================================================
+A boundary-finding thread (see findSeparators()): its chunk of report1,
+and where in it the invoices' beginnings (at[STARTS]) and endings
+(at[ENDS]) are, count[] of each, in order.
+=======================================================================*/
+enum { STARTS, ENDS };
+#define SEPARATOR "===\nIssued on behalf of "
+#define ISSUED    "Issued on behalf of "
+#define MINCHUNK (1UL << 20)       /* bytes of report1 per thread, at least */
+
+struct boundaryScan {
+  pthread_t          thread;
+  int                started;      /* TRUE if thread was started (else it ran in line) */
+  const char        *text;         /* all of report1, len bytes */
+  unsigned long int  len;
+  const char        *from, *to;    /* its chunk */
+  const char       **at[2];
+  unsigned long int  count[2];
+  unsigned long int  room[2];
+  int                rc;           /* 20 if it ran out of memory */
+};
+
+
+/*=====================================================================
+An extraction thread (see extractRows()): the run of invoices it does,
+and the CSV rows it has made of them so far, kept to itself until every
+thread is done.
+=======================================================================*/
+struct extractor {
+  pthread_t             thread;
+  int                   started;   /* TRUE if thread was started (else main() did the work) */
+  const char           *textEnd;   /* just past the end of report1 */
+  const struct invoice *first;     /* its first invoice */
+  unsigned long int     count;     /* and how many */
+  char                 *rows;      /* its rows, rowsLen bytes (in rowsRoom) */
+  unsigned long int     rowsLen;
+  unsigned long int     rowsRoom;
+  unsigned long int     done;      /* invoices done so far (for showProgress()) */
+  int                   finished;  /* TRUE once it's stopped */
+  int                   rc;        /* 0, or why it stopped early (see rowFailed()) */
+  char                  invNum[INVNUMMAX]; /* the invoice number of the one it stopped at */
 };
 
 
 /* A cleanup function to close files and free memory.  */
-void cleanup(int code, FILE *raw, FILE *csv, char *buffp, struct invoices *llistp);
+void cleanup(int code, FILE *csv, struct report1 *r1, struct invoice *spans);
+
+/* Loading report1 */
+int loadReport1(const char *fileName, struct report1 *r);
+void unloadReport1(struct report1 *r);
+
+/* Finding the invoices and their fields */
+int streamInvoices(FILE *in, const char *outFileName);
+int findInvoices(const char *text, unsigned long int len, int threads,
+                 struct invoice **spans, unsigned long int *invCount);
+void *findSeparators(void *arg);
+const char *nextSeparator(struct boundaryScan *scans, unsigned long int chunks, int kind,
+                          unsigned long int *c, unsigned long int *i, const char *from);
+void freeScans(struct boundaryScan *scans, unsigned long int chunks);
+void rowFailed(int code, const char *invNum);
+void *extractRows(void *arg);
+void showProgress(struct extractor *ex, int threads, unsigned long int invCount);
+
 
 
 
@@ -113,191 +215,103 @@ void cleanup(int code, FILE *raw, FILE *csv, char *buffp, struct invoices *llist
 int main(int argc, char *argv[]) {
   FILE *rawTextFile;
   FILE *csvFile;
-  unsigned long int charCountA, charCountB;
   char inFileName[MAXFNAMELEN+5];
   char outFileName[MAXFNAMELEN+5];
-  int i, j;
-  int ch;
-  int invCount;
-  char *startBufferp;  /* the start of the in-storage buffer containing the file */
-  char *startp, *endp; /* the starting and ending address of an individual invoice */
-  char *w, *x;         /* work pointers */
-  char invNum[30];
-  char invDate[20];
-  char taxPointDate[20];
-  char restaurantName[RESTAURANTMAX];
-  char gstNumber[20];
-  char netAmt[10];
-  char grossAmt[10];
-  char hstAmt[10];
-  struct invoices *p,
-                  *firstNode=NULL,
-                  *prevNode=NULL;
-
-
-  puts("Generating report 2...");
-
-
-  /* Handle command line arguments. */
-  if ( argc != 3 ) {
-    printf("Usage: %s inputFilename outputFilename\n", argv[0]);
+  unsigned long int invCount;
+  struct report1 report1;      /* all of report1, in memory (see loadReport1()) */
+  struct invoice *spans=NULL;  /* where each invoice is (see findInvoices()) */
+  struct extractor *ex;        /* one per thread (see extractRows()) */
+  int threads, t, argi;
+  int usage;
+  long int n;
+  char *end;
+  int streamMode;
+  int rc;
+
+
+  /* Handle command line arguments.  -t must be a whole number (0: one per processor). */
+  threads = 0;
+  streamMode = FALSE;
+  usage = FALSE;
+  argi = 1;
+  while ( argi < argc-2 ) {
+    if ( strcmp(argv[argi],"-t")==0 ) {
+      n = strtol(argv[argi+1], &end, 10);
+      usage |= ( argv[argi+1][0]<'0' || argv[argi+1][0]>'9' || *end!='\0' );
+      threads = n>MAXTHREADS ? MAXTHREADS : (int)n;
+      argi += 2;
+    }
+    else if ( strcmp(argv[argi],"-stream")==0 ) {
+      streamMode = TRUE;
+      argi++;
+    }
+    else
+      break;
+  }
+  if ( usage || argc != argi+2 ) {
+    printf("Usage: %s [-t threads] inputFilename outputFilename\n"
+           "       %s -stream {inputFilename | -} outputFilename\n", argv[0], argv[0]);
     return 17;
   }
-  if ( strlen(argv[1]) > MAXFNAMELEN ) {
+  puts("Generating report 2...");
+  if ( strlen(argv[argi]) > MAXFNAMELEN ) {
     puts("Input file name too long.  Aborting.");
     return 18;
   }
   else
-    strcpy(inFileName,argv[1]);
-  if ( strlen(argv[2]) > MAXFNAMELEN ) {
+    strcpy(inFileName,argv[argi]);
+  if ( strlen(argv[argi+1]) > MAXFNAMELEN ) {
     puts("Output file name too long.  Aborting.");
     return 19;
   }
   else
-    strcpy(outFileName,argv[2]);
-
-
-  /* Open the raw text file. */
-  rawTextFile=fopen(inFileName,"r");
-  if (!rawTextFile) {
-    puts("Opening raw text file failed.  Aborting.");
-    cleanup(1,NULL,NULL,NULL,NULL);
-    return 1;
-  }
-
-
-  /*=============================================
-  Make sure the file isn't too big.  (Reserve one
-  extra byte for the '\0' we're going to append.)
-  ===============================================*/
-  charCountA=0LU;
-  while ((ch=getc(rawTextFile)) != EOF) {
-    charCountA++;
-    if (charCountA==(MAX_SIZE-1)) {
-      puts("Too many invoices.  Aborting.");
-      cleanup(2,rawTextFile,NULL,NULL,NULL);
-      return 2;
+    strcpy(outFileName,argv[argi+1]);
+  if ( threads < 1 )
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if ( threads < 1 )
+    threads = 1;
+  if ( threads > MAXTHREADS )
+    threads = MAXTHREADS;
+  buildLabels();
+
+
+  /* Stream report1 (always, when it's stdin), or read it all in. */
+  if ( streamMode || strcmp(inFileName,"-")==0 ) {
+    if ( strcmp(inFileName,"-")==0 )
+      rawTextFile=stdin;
+    else
+      rawTextFile=fopen(inFileName,"r");
+    if (!rawTextFile) {
+      puts("Opening raw text file failed.  Aborting.");
+      return 1;
     }
+    rc = streamInvoices(rawTextFile, outFileName);
+    if ( rawTextFile!=stdin )
+      fclose(rawTextFile);
+    return rc;
   }
 
 
-  /*===========================================================
-  Allocate enough space to hold the whole file in memory, plus
-  one extra byte for the '\0' that we're going to append to it.
-  =============================================================*/
-  startBufferp=(char *)malloc(charCountA+1);
-  if (!startBufferp) {
-    printf("malloc() failed to allocate %lu bytes\nAborting.", charCountA+1);
-    cleanup(3,rawTextFile,NULL,NULL,NULL);
-    return 3;
-  }
-
-
-  /*================================================================
-  Read the whole file into memory and append a '\0' byte to the end.
-  The nul byte will stop string functions list strstr() from going
-  past the last invoice.
-  ==================================================================*/
-  rewind(rawTextFile);
-  charCountB=0LU;
-  w=startBufferp;
-  while ((ch=getc(rawTextFile)) != EOF) {
-    charCountB++;
-    *w++=ch;
-  }
-  if (charCountA!=charCountB) {
-    puts("Byte count mismatch.  Possible error reading file into memory.  Aborting.");
-    cleanup(4,rawTextFile,NULL,startBufferp,NULL);
-    return 4;
-  }
-  *w='\0';
-
-
-  /*====================================================
-  We now have the whole file in memory and it's been
-  nul-terminated.  The disk version is no longer needed.
-  ======================================================*/
-  fclose(rawTextFile);
+  /*=================================================================
+  Bring report1 into memory: mapped read-only, if it's a file (see
+  loadReport1()).  Nothing from here on needs a '\0' at the end of
+  it; every search and every field stops at report1.len bytes.
+  ===================================================================*/
+  rc = loadReport1(inFileName, &report1);
+  if ( rc )
+    return rc;
 
 
   /*==========================================================
   The first invoice is preceded by a long row of equal signs.
   Every invoice is also FOLLOWED by a long row of equal signs,
-  including the last one.
-
-  To search for the beginning of an invoice, look for this
-  string of characters: '===\nIssued on behalf of '.  All
-  invoices start at the letter 'I' in the word 'Issued'.
-
-  To find the end of a given invoice, look for this string of
-  characters: '\n==='.  Each invoice ends at the character
-  just before the newline.
-
-  Let's now get the starting and ending addresses of the very
-  first invoice.
+  including the last one.  Find where every invoice starts and
+  ends (see findInvoices()).
   ============================================================*/
-  w=strstr(startBufferp,"===\nIssued on behalf of ");
-  if ( !w ) {
-    puts("Couldn't find beginning of first invoice.  Aborting.");
-    cleanup(5,NULL,NULL,startBufferp,NULL);
-    return 5;
-  }
-  startp=w+4;          /* the 'I' in Issued */
-  w=strstr(w,"\n===");
-  if ( !w ) {
-    puts("Couldn't find ending of first invoice.  Aborting.");
-    cleanup(6,NULL,NULL,startBufferp,NULL);
-    return 6;
-  }
-  endp=w-1;            /* the character just prior to the newline */
-
-
-  /*================================================================
-  We can now create the first node in the linked list.  There is one
-  node for each invoice.  In each node, we store the starting and
-  ending addresses of an invoice.
-  ==================================================================*/
-  p = (struct invoices *) malloc(sizeof(struct invoices));
-  if ( !p ) {
-    puts("No memory for first linked-list node.  Aborting.");
-    cleanup(20,NULL,NULL,startBufferp,NULL);
-    return 20;
-  }
-  p->firstByte = startp;
-  p->lastByte  = endp;
-  p->next      = NULL;
-  firstNode = prevNode = p;
-
-
-  /*============================================================
-  Find all remaining invoices and add them to the linked-list.
-
-  Our work pointer, w, was left pointing at the end of the first
-  invoice.  Continue using w to find all the remaining invoices.
-  (When there are no more to be found, w becomes NULL.)
-  ==============================================================*/
-  w=strstr(w,"===\nIssued on behalf of ");
-  while (w) {
-    startp=w+4;          /* the 'I' in Issued */
-    w=strstr(w,"\n===");
-    if ( !w ) {
-      puts("Couldn't find the end of one of the invoices.  Aborting.");
-      cleanup(7,NULL,NULL,startBufferp,firstNode);
-      return 7;
-    }
-    endp=w-1;            /* the character just prior to the newline */
-    p = (struct invoices *) malloc(sizeof(struct invoices));
-    if ( !p ) {
-      puts("No memory for new linked-list node.  Aborting.");
-      cleanup(21,NULL,NULL,startBufferp,NULL);
-      return 21;
-    }
-    p->firstByte = startp;
-    p->lastByte  = endp;
-    p->next      = NULL;
-    prevNode->next = p;
-    prevNode = p;
-    w=strstr(w,"===\nIssued on behalf of ");
+  rc = findInvoices(report1.text, report1.len, threads, &spans, &invCount);
+  if ( rc ) {
+    cleanup(rc,NULL,&report1,spans);
+    return rc;
   }
 
 
@@ -305,13 +319,13 @@ int main(int argc, char *argv[]) {
   csvFile=fopen(outFileName,"w");
   if (!csvFile) {
     puts("Error opening CSV file.  Aborting.");
-    cleanup(8,NULL,NULL,startBufferp,firstNode);
+    cleanup(8,NULL,&report1,spans);
     return 8;
   }
   if (!fprintf(csvFile,"InvoiceNumber,InvoiceDate,TaxPointDate,Restaurant,"
                        "GSTNumber,TotalNet,TotalHST,GrossAmt\n")) {
     puts("Error writing to CSV file.  Aborting.");
-    cleanup(9,NULL,csvFile,startBufferp,firstNode);
+    cleanup(9,csvFile,&report1,spans);
     return 9;
   }
 
@@ -319,291 +333,654 @@ int main(int argc, char *argv[]) {
 
 
   /*=================================================================================
-  There is one node per invoice in our linked-list.  Traverse the entire linked-list 
-  and, for each invoice, extract the fields we need for the next row of the CSV file.
-  Output that row.
+  Each invoice's row of the CSV file depends on nothing but the invoice's own text,
+  so the invoices are shared out among the threads, each taking its own run of them,
+  in order (the first thread the first invoices, and so on).  Each thread keeps its
+  rows in a buffer of its own (see extractRows()), and once they've all finished the
+  buffers are written out one after another, so the CSV file is exactly what it
+  would be if one thread had done all the invoices.  Meanwhile, show how far along
+  they are (see showProgress()).
+
+  The rows themselves are made by fieldsRow() (in rpt2fields.c), which rpt1pgm's
+  -csv mode also uses on each invoice's text as it's extracted.
   ===================================================================================*/
-  invCount=0;
-  p = firstNode;
-  while (p) {
+  if ( (unsigned long int)threads > invCount )
+    threads = invCount;
+  ex = calloc(threads, sizeof(struct extractor));
+  if ( !ex ) {
+    puts("No memory for the extraction threads.  Aborting.");
+    cleanup(23,csvFile,&report1,spans);
+    return 23;
+  }
+  for ( t=0; t<threads; t++ ) {
+    ex[t].textEnd = report1.text + report1.len;
+    ex[t].first = spans + invCount*t/threads;
+    ex[t].count = invCount*(t+1)/threads - invCount*t/threads;
+    ex[t].started = ( pthread_create(&ex[t].thread, NULL, extractRows, &ex[t]) == 0 );
+    if ( !ex[t].started )
+      extractRows(&ex[t]);          /* couldn't start it: do its share here */
+  }
+  showProgress(ex, threads, invCount);
+  for ( t=0; t<threads; t++ ) {
+    if ( ex[t].started )
+      pthread_join(ex[t].thread, NULL);
+  }
 
 
-        startp = p->firstByte; /* the address of the first byte of this invoice */
-        endp   = p->lastByte;  /* the address of the last byte of this invoice */
+  /*=================================================================
+  Write the rows out in invoice order, up to the first invoice that
+  couldn't be done, if there was one, and stop there, with its code.
+  ===================================================================*/
+  rc = 0;
+  for ( t=0; t<threads && !rc; t++ ) {
+    if ( ex[t].rowsLen && fwrite(ex[t].rows, 1, ex[t].rowsLen, csvFile) != ex[t].rowsLen ) {
+      puts("Error writing to CSV file.  Aborting.");
+      rc = 16;
+    }
+    else if ( ex[t].rc ) {
+      rc = ex[t].rc;
+      rowFailed(rc, ex[t].invNum);
+    }
+  }
+  for ( t=0; t<threads; t++ )
+    free(ex[t].rows);
+  free(ex);
+  cleanup(rc,csvFile,&report1,spans);
+  return rc;
+}
 
 
-        /*===============================================================================
-        Every invoice should have an invoice number.  It's on a line that begins with the
-        text 'Invoice Number:  '.  (Note the two spaces after the colon.)  Scoop up the
-        rest of the line and replace the '\n' at the end with a '\0'.
-        =================================================================================*/
-        x=strstr(startp,"\nInvoice Number:  ");
-        if ( !x || (x>endp) ) {
-          puts("\nInvoice found without an invoice number.  Aborting.");
-          cleanup(10,NULL,csvFile,startBufferp,firstNode);
-          return 10;
-        }
-        x+=strlen("\nInvoice Number:  ");
-        w=invNum;
-        while ( *x != '\n' ) {
-          *w++ = *x++;
-        }
-        *w='\0';
-
-
-        /*====================================================================
-        Do the same for the invoice date but enclose the date in double quotes
-        since it contains a comma.  (CSV-file rules require this.)
-        ======================================================================*/
-        x=strstr(startp,"\nInvoice Date:  ");
-        if ( !x || (x>endp) ) {
-          printf("\nInvoice %s does not have an invoice date.  Aborting.\n",invNum);
-          cleanup(11,NULL,csvFile,startBufferp,firstNode);
-          return 11;
-        }
-        x+=strlen("\nInvoice Date:  ");
-        w=invDate;
-        *w++='\"';
-        while ( *x != '\n' )
-          *w++ = *x++;
-        *w++='\"';
-        *w='\0';
-
-
-        /*===================================================================
-        The tax point date is a little tricky.  It's not always present.
-
-        Sometime around March 15, 2021, Uber seems to have stopped putting
-        tax point dates in trip invoices.  Even an invoice that contains
-        the text 'Tax Point Date' doesn't necessarily have one.  (All
-        invoices still contain an invoice date though.)
-
-        I've noticed that invoices that actually do contain a tax point date
-        also have a line that starts with 'Delivery service'.  In that case,
-        the tax point date is the entire line immediately above the
-        'Delivery service' line.
-
-        As with the invoice date, the tax point date contains a comma, so we
-        have to enclose it in double quotes.
-
-        If an invoice does NOT contain a tax point date, we set the tax point
-        date field to 'notSpecified' in the CSV file.
-        =====================================================================*/
-        strcpy(taxPointDate,"notSpecified");
-        x=strstr(startp,"\nDelivery service");
-        if ( x && (x<endp) ) {
-          w=taxPointDate;
-          *w++='\"';
-          x--;
-          while ( *x != '\n' )                    /* Back up to the previous newline... */
-            x--;
-          x++;
-          while ( *x != '\n' )          /* ...and go forward again, capturing the date. */
-            *w++ = *x++;
-          w--;  /* There's always a blank at the end of the tax point date.  Remove it. */
-          *w++='\"';
-          *w='\0';
+
+
+
+
+void cleanup(int code, FILE *csv, struct report1 *r1, struct invoice *spans) {
+  /*==========================================================================
+  There are many points in the mainline where an error is detected and control
+  must be returned to the operating system.  Depending on where we are in our
+  processing, there may be files we've opened that need to be closed or
+  dynamic memory that we've allocated that needs to be freed.
+
+  We're passed an action code to tell us what to clean up.  (Doing all the
+  clean up in a function helps keep the mainline uncluttered.)
+  ============================================================================*/
+
+  switch (code) {
+    case 0:
+    case 9:
+    case 10:
+    case 11:
+    case 12:
+    case 13:
+    case 14:
+    case 15:
+    case 16:
+    case 23:
+    case 24: fclose(csv);
+             unloadReport1(r1);
+             free(spans);
+             break;
+    case 1:                 /* no action needed (see loadReport1()) */
+    case 2:
+    case 3:
+    case 4:  break;
+    case 5:
+    case 6:
+    case 7:
+    case 8:
+    case 20:
+    case 21: unloadReport1(r1);
+             free(spans);
+             break;
+  }
+}
+
+
+
+
+
+
+int loadReport1(const char *fileName, struct report1 *r) {
+  /*==========================================================================
+  Bring report1 into memory.  A regular file is mapped read-only with
+  mmap(), which costs no copying at all, with hints that it's going to be
+  read front to back and all of it, so the kernel reads ahead as far as
+  it can.  A big one is mapped at a huge-page boundary (HUGEPAGE), inside
+  a reservation one huge page bigger than it, so that where the kernel can
+  back a file with huge pages, it can do so from the first byte.
+
+  Anything that can't be mapped (a named pipe, say) is read() into a
+  buffer in big chunks instead, growing the buffer as needed.
+  ============================================================================*/
+
+  struct stat sb;
+  char *bigger, *aligned;
+  unsigned long int room;
+  ssize_t bytesRead;
+  int fd;
+
+  memset(r, 0, sizeof(*r));
+  fd=open(fileName,O_RDONLY);
+  if ( fd<0 ) {
+    puts("Opening raw text file failed.  Aborting.");
+    return 1;
+  }
+  if ( fstat(fd,&sb)==0 && S_ISREG(sb.st_mode) && sb.st_size>0 ) {
+    if ( (off_t)(unsigned long int)sb.st_size != sb.st_size ) {
+      puts("Too many invoices.  Aborting.");
+      close(fd);
+      return 2;
+    }
+    r->len = sb.st_size;
+    r->mapLen = r->len;
+    if ( r->len >= HUGEPAGE )
+      r->mapLen += HUGEPAGE;
+    r->map = mmap(NULL, r->mapLen, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if ( r->map != MAP_FAILED ) {
+      aligned = r->map;
+      if ( r->len >= HUGEPAGE )
+        aligned += (HUGEPAGE - (unsigned long int)aligned % HUGEPAGE) % HUGEPAGE;
+      r->text = mmap(aligned, r->len, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0);
+      if ( r->text != MAP_FAILED ) {
+        r->mapped = TRUE;
+        (void)madvise((char *)r->text, r->len, MADV_SEQUENTIAL);
+        (void)madvise((char *)r->text, r->len, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+        if ( r->len >= HUGEPAGE )
+          (void)madvise((char *)r->text, r->len, MADV_HUGEPAGE);
+#endif
+      }
+      else
+        munmap(r->map, r->mapLen);
+    }
+  }
+  if ( !r->mapped ) {
+    r->len = 0;
+    r->buf = NULL;
+    room = READCHUNK;
+    for (;;) {
+      if ( r->len==room || !r->buf ) {
+        if ( r->buf )
+          room *= 2;
+        bigger = realloc(r->buf, room);
+        if ( !bigger ) {
+          printf("malloc() failed to allocate %lu bytes\nAborting.", room);
+          free(r->buf);
+          close(fd);
+          return 3;
         }
+        r->buf = bigger;
+      }
+      bytesRead = read(fd, r->buf+r->len, room-r->len);
+      if ( bytesRead<0 ) {
+        puts("Error reading the raw text file.  Aborting.");
+        free(r->buf);
+        close(fd);
+        return 4;
+      }
+      if ( bytesRead==0 )
+        break;
+      r->len += bytesRead;
+    }
+    r->text = r->buf;
+  }
+  close(fd);
+  return 0;
+}
+
+
+
+
+void unloadReport1(struct report1 *r) {
+  /* Undo loadReport1(). */
+
+  if ( r->mapped )
+    munmap(r->map, r->mapLen);
+  else
+    free(r->buf);
+}
+
 
 
-        /*==========================================================
-        Every invoice has a restaurant name.
 
-        It's on the line following the line that starts with the
-        text 'Uber Portier B.V.'.
 
-        It's conceivable that a restaurant's name contains a comma,
-        so, to be safe, we always enclose the name in double quotes.
-        We also truncate the restaurant's name if it's too long.
 
-        Pray that we never see a restaurant name with a double
-        quote in it.  (We would need to modify this code to double
-        each of those double quotes.)
-        ============================================================*/
-        x=strstr(startp,"\nUber Portier B.V.");
-        if ( !x || (x>endp) ) {
-          printf("\nInvoice %s does not contain 'Uber Portier B.V.'.  Aborting.\n",invNum);
-          cleanup(12,NULL,csvFile,startBufferp,firstNode);
-          return 12;
+int streamInvoices(FILE *in, const char *outFileName) {
+  /*==========================================================================
+  For 'rpt2pgm -stream' (and report1 '-', stdin): make report2 from report1
+  as it's read, a block (STREAMBLOCK bytes) at a time, one invoice at a time,
+  keeping no more of report1 in memory than the invoice being looked at and
+  the block it ends in.  So report1 may be as big as it likes, and needn't
+  be a file: 'rpt1pgm -a - ... | rpt2pgm - report2' works.
+
+  The beginnings and endings are the same ones findInvoices() finds: an
+  invoice begins at the first '===\nIssued on behalf of ' after the last
+  one's ending, and ends at the first '\n===' after that.  When either
+  isn't in what's been read yet, whatever might be the start of it is kept
+  and the next block read in after it.
+
+  Each row is written as soon as its invoice has ended, so unlike the other
+  way, an invoice that never ends (RC 7) leaves the rows before it in the
+  CSV file, and an invoice with a field missing is reported even if one
+  after it never ends.  The CSV file isn't made until the first invoice has ended.
+  ============================================================================*/
+
+  FILE *csvFile = NULL;
+  char *buf = NULL, *bigger;
+  char *w;
+  unsigned long int bufLen = 0, room = 0, scan = 0, start = 0, keepFrom;
+  unsigned long int invCount = 0;
+  size_t got;
+  struct invoice inv;
+  char row[MAXROW];
+  char invNum[INVNUMMAX];
+  int rowLen;
+  int lookingForEnd = FALSE, eof = FALSE;
+  int rc = 0;
+
+  for (;;) {
+
+    if ( !lookingForEnd ) {
+      /*===========================================================
+      Look for the next beginning.  If it isn't here, keep only the
+      bytes at the end that might be the start of one.
+      =============================================================*/
+      w = ( bufLen > scan ) ? memmem(buf+scan, bufLen-scan, SEPARATOR, sizeof(SEPARATOR)-1)
+                            : NULL;
+      if ( w ) {
+        start = scan = w-buf;
+        lookingForEnd = TRUE;
+        continue;
+      }
+      if ( eof ) {
+        if ( invCount==0 ) {
+          puts("Couldn't find beginning of first invoice.  Aborting.");
+          rc = 5;
         }
-        x++;
-        while ( *x++ != '\n' )      /* Ignore the rest of this line. */
-          ;
-        /*======================================================
-        Prepare to truncate the restaurant's name, if necessary.
-        We need to reserve 3 bytes for the 2 enclosing double
-        quotes and the string's terminating nul.
-        ========================================================*/
-        w=restaurantName;
-        *w++='\"';
-        j = RESTAURANTMAX - 3;    /* At most, copy this many bytes. */
-        for ( i=0; i<j; i++ ) {
-          if ( *x == '\n' )
+        break;
+      }
+      keepFrom = ( bufLen > scan+sizeof(SEPARATOR)-2 ) ? bufLen-(sizeof(SEPARATOR)-2) : scan;
+      if ( keepFrom ) {
+        memmove(buf, buf+keepFrom, bufLen-keepFrom);
+        bufLen -= keepFrom;
+      }
+      scan = 0;
+    }
+
+    else {
+      /*============================================================
+      Look for the ending of the invoice that begins at 'start'.  If
+      it's here, the invoice's row can be made and written, and all
+      that's before the ending let go.  If it isn't, keep the invoice
+      and read some more.
+      ==============================================================*/
+      w = ( bufLen > scan ) ? memmem(buf+scan, bufLen-scan, "\n===", 4) : NULL;
+      if ( w ) {
+        inv.firstByte = buf+start+4;   /* the 'I' in Issued */
+        inv.lastByte  = w-1;           /* the character just prior to the newline */
+        if ( !csvFile ) {
+          csvFile = fopen(outFileName,"w");
+          if ( !csvFile ) {
+            puts("Error opening CSV file.  Aborting.");
+            rc = 8;
             break;
-          *w++ = *x++;
-        }
-        *w++='\"';
-        *w='\0';
-
-
-        /*=============================================================
-        Every invoice has two GST registration numbers, one for the
-        restaurant and one for the driver.
-
-        The restaurant's GST number appears first and is on a line that
-        starts with the text 'GST Registration Number: '.
-        ===============================================================*/
-        x=strstr(startp,"\nGST Registration Number: ");
-        if ( !x || (x>endp) ) {
-          printf("\nInvoice %s does not contain a GST registration number.  Aborting.\n",invNum);
-          cleanup(13,NULL,csvFile,startBufferp,firstNode);
-          return 13;
+          }
+          if (!fprintf(csvFile,"InvoiceNumber,InvoiceDate,TaxPointDate,Restaurant,"
+                               "GSTNumber,TotalNet,TotalHST,GrossAmt\n")) {
+            puts("Error writing to CSV file.  Aborting.");
+            rc = 9;
+            break;
+          }
         }
-        x+=strlen("\nGST Registration Number: ");
-        w=gstNumber;
-        while ( *x != '\n' )
-          *w++ = *x++;
-        *w++='\0';
-
-
-        /*=======================================================
-        Every invoice has a net amount.  It's the value found on
-        the line following the line that contains only this text:
-        'Total Net '.
-
-        The value starts at the first byte of the line and is
-        followed by at least one blank.
-        =========================================================*/
-        x=strstr(startp,"\nTotal Net \n");
-        if ( !x || (x>endp) ) {
-          printf("\nInvoice %s does not contain a net amount.  Aborting.\n",invNum);
-          cleanup(14,NULL,csvFile,startBufferp,firstNode);
-          return 14;
+        rc = fieldsRow(inv.firstByte, inv.lastByte, buf+bufLen, row, &rowLen, invNum);
+        if ( rc ) {
+          rowFailed(rc, invNum);
+          break;
         }
-        x+=strlen("\nTotal Net \n");
-        w=netAmt;
-        while ( *x != ' ' )
-          *w++ = *x++;
-        *w++='\0';
-
-
-        /*========================================================
-        Every invoice has a gross amount.  It's the value found on
-        the line following the line that contains only this text:
-        'Gross Amount '.
-
-        The value starts at the first byte of the line and is
-        followed by at least one blank.
-        ==========================================================*/
-        x=strstr(startp,"\nGross Amount \n");
-        if ( !x || (x>endp) ) {
-          printf("\nInvoice %s does not contain a gross amount.  Aborting.\n",invNum);
-          cleanup(15,NULL,csvFile,startBufferp,firstNode);
-          return 15;
+        if ( fwrite(row, 1, rowLen, csvFile) != (size_t)rowLen ) {
+          puts("\nError writing to CSV file.  Aborting.");
+          rc = 16;
+          break;
         }
-        x+=strlen("\nGross Amount \n");
-        w=grossAmt;
-        while ( *x != ' ' )
-          *w++ = *x++;
-        *w++='\0';
-
-
-        /*=========================================================
-        Not all invoices contain an HST amount.  If the invoice has
-        a line that contains only the text 'Total HST Amount ',
-        then the HST amount is on the line following that one.
-
-        The HST starts at the first byte and is followed by at
-        least one blank.
-
-        If the invoice does not have an HST amount, we set the
-        HST value to '0.00'.
-        ===========================================================*/
-        strcpy(hstAmt,"0.00");
-        x=strstr(startp,"\nTotal HST Amount \n");
-        if ( x && (x<endp) ) {
-          x+=strlen("\nTotal HST Amount \n");
-          w=hstAmt;
-          while ( *x != ' ' )
-            *w++ = *x++;
-          *w++='\0';
+        if ( ++invCount % 1000 == 0 ) {
+          printf("\r%lu invoices", invCount);
+          fflush(stdout);
         }
+        scan = w-buf;
+        memmove(buf, buf+scan, bufLen-scan);
+        bufLen -= scan;
+        scan = 0;
+        lookingForEnd = FALSE;
+        continue;
+      }
+      if ( eof ) {
+        if ( invCount==0 )
+          puts("Couldn't find ending of first invoice.  Aborting.");
+        else
+          puts("\nCouldn't find the end of one of the invoices.  Aborting.");
+        rc = ( invCount==0 ) ? 6 : 7;
+        break;
+      }
+      memmove(buf, buf+start, bufLen-start);
+      bufLen -= start;
+      scan   -= start;
+      start   = 0;
+      if ( bufLen > scan+3 )
+        scan = bufLen-3;               /* an ending could start in the last 3 bytes */
+    }
 
 
-        /* We have all the fields we need.  Add a new row to the CSV file. */
-        if (!fprintf(csvFile,"%s,%s,%s,%s,%s,%s,%s,%s\n",invNum,invDate,taxPointDate,restaurantName,
-                                                         gstNumber,netAmt,hstAmt,grossAmt)) {
-          puts("Error writing to CSV file.  Aborting.");
-          cleanup(16,NULL,csvFile,startBufferp,firstNode);
-          return 16;
-        }
+    /*==========================================================
+    Read the next block in after what's been kept.  The buffer
+    only grows when an invoice is bigger than it.
+    ============================================================*/
+    if ( bufLen+STREAMBLOCK > room ) {
+      room = ( 2*room > bufLen+STREAMBLOCK ) ? 2*room : bufLen+STREAMBLOCK;
+      bigger = realloc(buf, room);
+      if ( !bigger ) {
+        printf("\nNo memory for an invoice of %lu bytes.  Aborting.\n", bufLen);
+        rc = 25;
+        break;
+      }
+      buf = bigger;
+    }
+    got = fread(buf+bufLen, 1, STREAMBLOCK, in);
+    bufLen += got;
+    if ( got < STREAMBLOCK ) {
+      if ( ferror(in) ) {
+        puts("\nError reading report1.  Aborting.");
+        rc = 26;
+        break;
+      }
+      eof = TRUE;
+    }
+  }
+
+  if ( !rc )
+    printf("\r%lu invoices\n", invCount);
+  if ( csvFile )
+    fclose(csvFile);
+  free(buf);
+  return rc;
+}
 
 
-        invCount++;
-        printf("%d ", invCount);
-        p = p->next;           /* continue with next invoice */
+
+
+
+
+int findInvoices(const char *text, unsigned long int len, int threads,
+                 struct invoice **spans, unsigned long int *invCount) {
+  /*==========================================================================
+  Find the first and last bytes of every invoice in report1 (text, len
+  bytes), into an array (*spans, which the caller frees) of *invCount.
+
+  To search for the beginning of an invoice, look for this string of
+  characters: '===\nIssued on behalf of '.  All invoices start at the
+  letter 'I' in the word 'Issued'.
+
+  To find the end of a given invoice, look for this string of characters:
+  '\n==='.  Each invoice ends at the character just before the newline.
+  Then look for the next beginning from there, and so on.
+
+  Both strings have a newline in them, so report1 is cut into chunks, one
+  per thread (but none smaller than MINCHUNK), and each thread looks at
+  every newline in its chunk to list the beginnings and endings that it's
+  part of (see findSeparators()), reading past the end of the chunk where
+  one of them starts inside it and ends outside it.  Then, here, the lists
+  are walked in order, taking the first beginning, the first ending after
+  it, the first beginning after that, and so on, which is exactly what a
+  strstr() for each in turn, from the start of report1, would find.
+  ============================================================================*/
+
+  struct boundaryScan *scans;
+  struct invoice *bigger;
+  const char *start, *end;
+  unsigned long int room = 1024;
+  unsigned long int chunks, c, sc, si, ec, ei;
+  int rc;
+
+  *invCount = 0;
+  *spans = NULL;
+  chunks = len / MINCHUNK + 1;
+  if ( chunks > (unsigned long int)threads )
+    chunks = threads;
+  scans = calloc(chunks, sizeof(struct boundaryScan));
+  if ( !scans ) {
+    puts("No memory for the list of invoices.  Aborting.");
+    return 20;
   }
-  puts("");
-  cleanup(0,NULL,csvFile,startBufferp,firstNode);
+  for ( c=0; c<chunks; c++ ) {
+    scans[c].text = text;
+    scans[c].len  = len;
+    scans[c].from = text + len*c/chunks;
+    scans[c].to   = text + len*(c+1)/chunks;
+    scans[c].started = ( chunks>1
+                         && pthread_create(&scans[c].thread, NULL, findSeparators, &scans[c]) == 0 );
+    if ( !scans[c].started )
+      findSeparators(&scans[c]);
+  }
+  rc = 0;
+  for ( c=0; c<chunks; c++ ) {
+    if ( scans[c].started )
+      pthread_join(scans[c].thread, NULL);
+    if ( scans[c].rc )
+      rc = scans[c].rc;
+  }
+  if ( !rc ) {
+    *spans = malloc(room*sizeof(struct invoice));
+    if ( !*spans )
+      rc = 20;
+  }
+  if ( rc ) {
+    puts("No memory for the list of invoices.  Aborting.");
+    freeScans(scans, chunks);
+    return rc;
+  }
+
+
+  /* Walk the lists: the first beginning, the first ending after it, and so on. */
+  sc = si = ec = ei = 0;
+  start = nextSeparator(scans, chunks, STARTS, &sc, &si, text);
+  if ( !start ) {
+    puts("Couldn't find beginning of first invoice.  Aborting.");
+    freeScans(scans, chunks);
+    return 5;
+  }
+  while ( start ) {
+    if ( *invCount==room ) {
+      bigger = realloc(*spans, 2*room*sizeof(struct invoice));
+      if ( !bigger ) {
+        puts("No memory for a longer list of invoices.  Aborting.");
+        freeScans(scans, chunks);
+        return 21;
+      }
+      *spans = bigger;
+      room  *= 2;
+    }
+    end = nextSeparator(scans, chunks, ENDS, &ec, &ei, start);
+    if ( !end ) {
+      if ( *invCount==0 )
+        puts("Couldn't find ending of first invoice.  Aborting.");
+      else
+        puts("Couldn't find the end of one of the invoices.  Aborting.");
+      freeScans(scans, chunks);
+      return ( *invCount==0 ) ? 6 : 7;
+    }
+    (*spans)[*invCount].firstByte  = start+4;  /* the 'I' in Issued */
+    (*spans)[(*invCount)++].lastByte = end-1;  /* the character just prior to the newline */
+    start = nextSeparator(scans, chunks, STARTS, &sc, &si, end);
+  }
+  freeScans(scans, chunks);
   return 0;
 }
 
 
 
 
+void *findSeparators(void *arg) {
+  /*==========================================================================
+  A boundary-finding thread (see findInvoices()): list, in order, where each
+  '===\nIssued on behalf of ' and each '\n===' in report1 is whose newline
+  is in the chunk from 'from' up to 'to'.  memchr() does the looking, a
+  vector's worth of bytes at a time.
+  ============================================================================*/
+
+  struct boundaryScan *b = (struct boundaryScan *)arg;
+  const char *textEnd = b->text + b->len;
+  const char *p = b->from;
+  int kind;
+
+  while ( p < b->to && (p = memchr(p, '\n', b->to-p)) ) {
+    kind = -1;
+    if ( textEnd-p >= 4 && memcmp(p+1, "===", 3)==0 )
+      kind = ENDS;
+    else if ( p-b->text >= 3 && memcmp(p-3, "===", 3)==0
+              && (unsigned long int)(textEnd-p-1) >= sizeof(ISSUED)-1
+              && memcmp(p+1, ISSUED, sizeof(ISSUED)-1)==0 )
+      kind = STARTS;
+    if ( kind>=0 ) {
+      if ( b->count[kind]==b->room[kind] ) {
+        b->room[kind] = ( b->room[kind] ) ? 2*b->room[kind] : 1024;
+        b->at[kind] = realloc(b->at[kind], b->room[kind]*sizeof(char *));
+        if ( !b->at[kind] ) {
+          b->rc = 20;
+          break;
+        }
+      }
+      b->at[kind][b->count[kind]++] = ( kind==STARTS ) ? p-3 : p;
+    }
+    p++;
+  }
+  return NULL;
+}
+
+
+
+
+const char *nextSeparator(struct boundaryScan *scans, unsigned long int chunks, int kind,
+                          unsigned long int *c, unsigned long int *i, const char *from) {
+  /*==========================================================================
+  The first beginning or ending (kind) in findSeparators()' lists that's at
+  or after 'from', or NULL.  *c and *i (chunk, and entry in its list) carry
+  on from where the last call for this kind left off, since 'from' only
+  ever moves forward.
+  ============================================================================*/
 
+  for ( ; *c<chunks; (*c)++, *i=0 ) {
+    for ( ; *i<scans[*c].count[kind]; (*i)++ ) {
+      if ( scans[*c].at[kind][*i] >= from )
+        return scans[*c].at[kind][*i];
+    }
+  }
+  return NULL;
+}
 
-void cleanup(int code, FILE *raw, FILE *csv, char *buffp, struct invoices *llistp) {
+
+
+
+void freeScans(struct boundaryScan *scans, unsigned long int chunks) {
+  /* Free findSeparators()' lists, and the chunks. */
+
+  unsigned long int c;
+
+  for ( c=0; c<chunks; c++ ) {
+    free(scans[c].at[STARTS]);
+    free(scans[c].at[ENDS]);
+  }
+  free(scans);
+}
+
+
+
+
+void *extractRows(void *arg) {
   /*==========================================================================
-  There are many points in the mainline where an error is detected and control
-  must be returned to the operating system.  Depending on where we are in our
-  processing, there may be files we've opened that need to be closed or
-  dynamic memory that we've allocated that needs to be freed.
+  An extraction thread: make the CSV rows for its run of invoices, in order,
+  into its own buffer, stopping at the first invoice that can't be done (its
+  code in rc and, if it has one, its invoice number in invNum).  done counts
+  the invoices finished so far, for showProgress().
+  ============================================================================*/
 
-  We're passed an action code to tell us what to clean up.  (Doing all the
-  clean up in a function helps keep the mainline uncluttered.)
+  struct extractor *e = (struct extractor *)arg;
+  char row[MAXROW];
+  char *bigger;
+  unsigned long int i, room;
+  int rowLen;
+
+  for ( i=0; i<e->count; i++ ) {
+    e->rc = fieldsRow(e->first[i].firstByte, e->first[i].lastByte, e->textEnd,
+                      row, &rowLen, e->invNum);
+    if ( e->rc )
+      break;
+    if ( e->rowsLen+rowLen > e->rowsRoom ) {
+      room = ( e->rowsRoom ) ? 2*e->rowsRoom : 65536;
+      bigger = realloc(e->rows, room);
+      if ( !bigger ) {
+        e->rc = 24;
+        break;
+      }
+      e->rows     = bigger;
+      e->rowsRoom = room;
+    }
+    memcpy(e->rows+e->rowsLen, row, rowLen);
+    e->rowsLen += rowLen;
+    __atomic_store_n(&e->done, i+1, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&e->finished, TRUE, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+
+
+
+void showProgress(struct extractor *ex, int threads, unsigned long int invCount) {
+  /*==========================================================================
+  Until every extraction thread has finished, show how many invoices they've
+  done between them, on one line, updated a few times a second.  (The
+  threads only count; they don't print anything themselves.)
   ============================================================================*/
 
-  struct invoices *p, *q;
+  struct timespec tick = { 0, 50000000 };   /* 50 ms */
+  unsigned long int done;
+  int finished, t;
+
+  for (;;) {
+    done = 0;
+    finished = 0;
+    for ( t=0; t<threads; t++ ) {
+      done     += __atomic_load_n(&ex[t].done, __ATOMIC_RELAXED);
+      finished += __atomic_load_n(&ex[t].finished, __ATOMIC_ACQUIRE);
+    }
+    printf("\r%lu of %lu invoices", done, invCount);
+    fflush(stdout);
+    if ( finished==threads )
+      break;
+    nanosleep(&tick, NULL);
+  }
+  puts("");
+}
+
+
+
+
+void rowFailed(int code, const char *invNum) {
+  /* Say why invoice invNum has no row (fieldsRow()'s or extractRows()'s code). */
 
   switch (code) {
-    case 0:
-    case 9:
-    case 10:
-    case 11:
-    case 12:
-    case 13:
-    case 14:
-    case 15:
-    case 16: fclose(csv);
-             free(buffp);
-             p=llistp;      /* free a linked-list */
-             while (p) {
-               q = p->next;
-               free(p);
-               p=q;
-             }
+    case 10: puts("\nInvoice found without an invoice number.  Aborting.");
              break;
-    case 1:  break;         /* no action needed */
-    case 2:
-    case 3:  fclose(raw);
+    case 11: printf("\nInvoice %s does not have an invoice date.  Aborting.\n",invNum);
              break;
-    case 4:  fclose(raw);
-             free(buffp);
+    case 12: printf("\nInvoice %s does not contain 'Uber Portier B.V.'.  Aborting.\n",invNum);
              break;
-    case 5:
-    case 6:
-    case 20:
-    case 21: free(buffp);
+    case 13: printf("\nInvoice %s does not contain a GST registration number.  Aborting.\n",invNum);
              break;
-    case 7:
-    case 8:  free(buffp);
-             p=llistp;      /* free a linked-list */
-             while (p) {
-               q = p->next;
-               free(p);
-               p=q;
-             }
+    case 14: printf("\nInvoice %s does not contain a net amount.  Aborting.\n",invNum);
+             break;
+    case 15: printf("\nInvoice %s does not contain a gross amount.  Aborting.\n",invNum);
+             break;
+    case 24: puts("\nNo memory for the CSV file's rows.  Aborting.");
              break;
   }
 }
@@ -11,7 +11,7 @@ automatically.
 
 Sample build:
 
-    gcc -o rpt3pgm rpt3pgm.c
+    gcc -O2 -o rpt3pgm rpt3pgm.c
 ======================================================================*/
 
 